@@ -2,7 +2,9 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstddef>
 #include <cstring>
+#include <optional>
 #include <string>
 
 namespace tinyrpc {
@@ -50,12 +52,30 @@ constexpr bool is_dynamic_container_v = std::conjunction_v<
 
 }  // namespace
 
+// a range of an open file, moved by sendfile/splice after the message
+// instead of being copied into it, at most one per message
+// an empty region is received with fd -1 unless it goes into a sink
+// ownership of fd: a region a server handler returns or passes to its
+// Responder is closed by the server once sent, so dup() a descriptor that
+// is kept open (e.g. cached), a region a handler receives is closed after
+// it returns unless it is returned, one sent by RpcClient stays with the
+// caller, one it receives into a temporary file is closed after func
+struct FileRegion {
+  int fd;
+  uint64_t offset;
+  uint64_t length;
+};
+
 class Message {
  public:
-  static constexpr uint32_t HeaderLength = 8;  // sizeof(header);
+  static constexpr uint32_t HeaderLength = 24;  // sizeof(header);
+  static constexpr uint32_t AttachmentOffset =
+      16;  // offsetof(header, attachment)
   static constexpr uint32_t MaxLength = 1 << 12;
 
   uint32_t Length() const { return header_.length; }
+  uint64_t TraceId() const { return header_.trace_id; }
+  uint64_t Attachment() const { return header_.attachment; }
 
   const std::string& GetErrorMessage() const {
     assert(IsError());
@@ -93,7 +113,7 @@ class Message {
   }
 
  protected:
-  Message() : header_{0U, 0U}, error_(std::nullopt) {
+  Message() : header_{0U, 0U, 0U, 0U}, error_(std::nullopt) {
     uint16_t value = 0x01;
     auto least_significant_byte = *reinterpret_cast<uint8_t*>(&value);
     endian_ = least_significant_byte == 0x01 ? endian::little : endian::big;
@@ -106,15 +126,22 @@ class Message {
   struct header {
     uint32_t identifier;
     uint32_t length;
+    uint64_t trace_id;    // 0 if the request is not traced
+    uint64_t attachment;  // bytes of a FileRegion following the message
   };
   enum class endian { little, big };
 
+  static_assert(sizeof(header) == HeaderLength &&
+                offsetof(header, attachment) == AttachmentOffset);
+
   header header_;
   std::optional<std::string> error_;
   endian endian_;
 
-  static constexpr uint32_t Magic =
-      0xc2a9c9a7;  // echo -n tinyrpc | md5sum: c2a9c9a7fd9ab6f3d6d18bfc49eb7f21
+  // changed with every header layout so that frames of an older peer are
+  // rejected instead of misparsed, 3: 24 byte header with trace id and
+  // attachment, echo -n tinyrpc3 | md5sum: 8d3f981a055715d423c0a32ba5bfbf02
+  static constexpr uint32_t Magic = 0x8d3f981a;
 };
 
 class Writer : public Message {
@@ -123,6 +150,9 @@ class Writer : public Message {
   Writer(const Writer& oth) = delete;
   Writer& operator=(const Writer& oth) = delete;
 
+  // must be set before the message is first read out
+  void SetTraceId(uint64_t trace_id) { header_.trace_id = trace_id; }
+
   std::string_view GetStringView() {
     if (!header_.identifier) {
       WriteHeader();
@@ -135,14 +165,24 @@ class Writer : public Message {
     }
     return data_;
   }
+  // to be sent right after the message, see FileRegion
+  const std::optional<FileRegion>& GetFileRegion() const { return region_; }
 
   template <typename T>
   Writer& operator<<(const T& obj) {
     if (IsError()) {  // if error occured before, just do nothing
       return *this;
     }
-    if constexpr (std::is_pointer_v<T>) {  // do not use raw c string, it will
-                                           // decay to char*
+    if constexpr (std::is_same_v<T, FileRegion>) {
+      if (region_) {
+        SetError("only one file region per message!");
+        return *this;
+      }
+      region_ = obj;
+      header_.attachment = obj.length;
+      return (*this) << obj.length;
+    } else if constexpr (std::is_pointer_v<T>) {  // do not use raw c string,
+                                                  // it will decay to char*
       SetError("pointer is dangerouse!");
       return *this;
     } else if constexpr (is_container_v<T>) {
@@ -182,6 +222,10 @@ class Writer : public Message {
     if (endian_ == endian::big) {
       ByteSwap(data_.data(), data_.data() + sizeof(header_.identifier));
       ByteSwap(data_.data() + sizeof(header_.identifier),
+               data_.data() + offsetof(header, trace_id));
+      ByteSwap(data_.data() + offsetof(header, trace_id),
+               data_.data() + offsetof(header, attachment));
+      ByteSwap(data_.data() + offsetof(header, attachment),
                data_.data() + sizeof(header));
     }
   }
@@ -200,6 +244,7 @@ class Writer : public Message {
   }
 
   std::string data_;
+  std::optional<FileRegion> region_;
 };
 
 class Reader : public Message {
@@ -219,12 +264,31 @@ class Reader : public Message {
   Reader(const Reader& oth) = delete;
   Reader& operator=(const Reader& oth) = delete;
 
+  // where the attachment of this message was received to
+  void SetFileRegion(const FileRegion& region) { region_ = region; }
+
   template <typename T>
   Reader& operator>>(T& obj) {
     if (IsError()) {
       return *this;
     }
-    if constexpr (std::is_pointer_v<T>) {
+    if constexpr (std::is_same_v<T, FileRegion>) {
+      uint64_t length;
+      (*this) >> length;
+      if (IsError()) {
+        return *this;
+      }
+      if (!region_ && !length) {  // nothing was attached
+        obj = FileRegion{-1, 0, 0};
+        return *this;
+      }
+      if (!region_ || region_->length != length) {
+        SetError("file region is not received!");
+        return *this;
+      }
+      obj = *region_;
+      return *this;
+    } else if constexpr (std::is_pointer_v<T>) {
       SetError("pointer is dangerouse!");
       return *this;
     } else if constexpr (is_dynamic_container_v<T>) {
@@ -232,6 +296,10 @@ class Reader : public Message {
     } else if constexpr (is_container_v<T>) {
       return ReadArray(obj);
     } else if constexpr (std::is_trivially_copyable_v<T>) {
+      if (data_.size() < sizeof(T)) {
+        SetError("message is too short!");
+        return *this;
+      }
       std::memcpy(&obj, data_.data(), sizeof(T));
       if (endian_ == endian::big) {
         if (!std::is_class_v<T>) {
@@ -261,6 +329,9 @@ class Reader : public Message {
     obj.clear();
     std::size_t sz;
     (*this) >> sz;
+    if (!CheckSize(sz)) {
+      return *this;
+    }
     for (std::size_t i = 0; i < sz; i++) {
       std::pair<U, V> value;
       (*this) >> value;
@@ -276,6 +347,9 @@ class Reader : public Message {
     obj.clear();
     std::size_t sz;
     (*this) >> sz;
+    if (!CheckSize(sz)) {
+      return *this;
+    }
     for (std::size_t i = 0; i < sz; i++) {
       std::pair<U, V> value;
       (*this) >> value;
@@ -286,11 +360,17 @@ class Reader : public Message {
 
  private:
   void ReadHeader() {
+    if (data_.size() < sizeof(header)) {
+      SetError("message is too short!");
+      return;
+    }
     std::memcpy(&header_, data_.data(), sizeof(header));
 
     if (endian_ == endian::big) {
       ByteSwap(&header_, &header_.length);
-      ByteSwap(&header_.length, &header_ + 1);
+      ByteSwap(&header_.length, &header_.trace_id);
+      ByteSwap(&header_.trace_id, &header_.attachment);
+      ByteSwap(&header_.attachment, &header_ + 1);
     }
     data_.remove_prefix(sizeof(header));
     if (header_.identifier != Magic) {
@@ -298,10 +378,25 @@ class Reader : public Message {
     }
   }
 
+  // every element takes at least one byte, so a larger count is corrupt
+  bool CheckSize(std::size_t sz) {
+    if (IsError()) {
+      return false;
+    }
+    if (sz > data_.size()) {
+      SetError("message is too short!");
+      return false;
+    }
+    return true;
+  }
+
   template <typename T>
   Reader& ReadArray(T& obj) {
     std::size_t sz;
     (*this) >> sz;
+    if (!CheckSize(sz)) {
+      return *this;
+    }
     for (auto& iter : obj) {
       (*this) >> iter;
     }
@@ -311,7 +406,10 @@ class Reader : public Message {
   Reader& ReadDynamicArray(T& obj) {
     std::size_t sz;
     (*this) >> sz;
-    typename T::value_type value;
+    if (!CheckSize(sz)) {
+      return *this;
+    }
+    typename T::value_type value{};
     for (std::size_t i = 0; i < sz; ++i) {
       (*this) >> value;
       obj.insert(obj.end(), value);
@@ -320,6 +418,7 @@ class Reader : public Message {
   }
 
   std::string_view data_;
+  std::optional<FileRegion> region_;
 };
 
 }  // namespace tinyrpc
\ No newline at end of file
@@ -2,12 +2,23 @@
 
 #include <any>
 #include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <optional>
 
 #include "message.hpp"
 #include "rpcserver.hpp"
+#include "tracer.hpp"
+#include "zerocopy.hpp"
 
 namespace tinyrpc {
 
+// Call never blocks: requests are queued on the io thread and pipelined on
+// the connection, the server answers them in order and func runs on the io
+// thread, so it may itself Call without waiting (e.g. from a handler)
+// func is not run for a call that fails, including an empty or undecodable
+// result (unknown method, dropped Responder) unless the result is void
 class RpcClient {
  public:
   RpcClient(const std::string& ip, uint16_t port)
@@ -19,18 +30,20 @@ class RpcClient {
   ~RpcClient() { Stop(); }
 
   void Start() {
-    socket_.async_connect(endpoint_, [](std::error_code error) {
+    socket_.async_connect(endpoint_, [this](std::error_code error) {
       if (error) {
+        Fail();
         return;
       }
+      connected_ = true;
+      Write();
     });
     work_thread_ = std::thread([this]() { io_context_.run(); });
   }
 
   void Stop() {
-    if (socket_.is_open()) {
-      asio::post(io_context_, [this]() { socket_.close(); });
-    }
+    // the socket is only touched on the io thread
+    asio::post(io_context_, [this]() { socket_.close(); });
     if (!io_context_.stopped()) {
       io_context_.stop();
     }
@@ -41,53 +54,231 @@ class RpcClient {
 
   template <typename RType, typename... Types, typename F>
   void Call(const std::string& name, F func, Types... args) {
-    CallImpl<RType>(name, func, args...);
+    CallImpl<RType>(std::nullopt, name, func, args...);
+  }
+
+  // like Call, but a file region in the result is received into sink
+  // instead of a temporary file that is closed once func returns
+  template <typename RType, typename... Types, typename F>
+  void CallInto(const FileRegion& sink, const std::string& name, F func,
+                Types... args) {
+    CallImpl<RType>(sink, name, func, args...);
   }
 
  private:
+  struct Request {
+    std::string data;
+    std::optional<FileRegion> upload;
+    std::optional<FileRegion> sink;
+    // decode the result and run func if it is there
+    std::function<void(Reader&)> finish;
+    uint64_t trace_id;
+    uint64_t begin;
+    uint64_t sent = 0;
+  };
+
+  // a file region in args is sent after the request, it stays owned by the
+  // caller and must not be closed before func runs
   template <typename RType, typename... Types, typename F>
-  void CallImpl(const std::string& name, F func, Types... args) {
+  void CallImpl(std::optional<FileRegion> sink, const std::string& name,
+                F func, Types... args) {
+    auto request = std::make_shared<Request>();
+    request->trace_id = Tracer::Instance().Sample();
+    request->begin = request->trace_id ? Tracer::Now() : 0;
     Writer writer;
+    writer.SetTraceId(request->trace_id);
     writer << name;
     static_cast<void>((writer << ... << args));
-    lock_.lock();
-    write_buffer_ = std::move(writer.GetString());
+    request->data = writer.GetString();
+    request->upload = writer.GetFileRegion();
+    request->sink = sink;
+    request->finish = [func](Reader& reader) mutable {
+      if constexpr (std::is_same_v<RType, void>) {
+        func();
+      } else {
+        RType result{};
+        reader >> result;
+        if (reader) {
+          func(result);
+        }
+      }
+    };
+    asio::post(io_context_, [this, request]() {
+      if (failed_) {
+        return;
+      }
+      requests_.push_back(request);
+      Write();
+    });
+  }
+
+  // write every queued request in one go, up to and including the first one
+  // followed by a file region, which is then sent with sendfile
+  void Write() {
+    if (!connected_ || writing_ || requests_.empty()) {
+      return;
+    }
+    writing_ = true;
+    std::optional<FileRegion> upload;
+    while (!requests_.empty() && !upload) {
+      auto& request = requests_.front();
+      write_buffer_ += request->data;
+      upload = request->upload;
+      sending_.push_back(request);
+      waiting_.push_back(std::move(request));
+      requests_.pop_front();
+    }
+    Read();
     asio::async_write(
         socket_, asio::buffer(write_buffer_),
-        [this, func](std::error_code error, std::size_t length) {
-          if (error) {
+        [this, upload](std::error_code error, std::size_t length) {
+          if (error || failed_) {
+            Fail();
+            return;
+          }
+          write_buffer_.clear();
+          if (!upload) {
+            Written();
             return;
           }
+          AsyncSendFile(socket_, *upload, [this](std::error_code error) {
+            if (error || failed_) {
+              Fail();
+              return;
+            }
+            Written();
+          });
+        });
+  }
+
+  void Written() {
+    for (auto& request : sending_) {
+      if (request->trace_id) {
+        request->sent = Tracer::Now();
+        Tracer::Instance().Record(request->trace_id, "send", request->begin,
+                                  request->sent);
+      }
+    }
+    sending_.clear();
+    writing_ = false;
+    Write();
+  }
+
+  // read the response to the oldest request still waiting for one
+  void Read() {
+    if (reading_ || waiting_.empty()) {
+      return;
+    }
+    reading_ = true;
+    asio::async_read(
+        socket_, asio::buffer(read_buffer_, Message::HeaderLength),
+        [this](std::error_code error, std::size_t length) {
+          if (error || failed_) {
+            Fail();
+            return;
+          }
+          Reader header(read_buffer_, length);
+          if (!header || header.Length() > Message::MaxLength) {
+            Fail();
+            return;
+          }
+          uint64_t attachment = header.Attachment();
           asio::async_read(
-              socket_, asio::buffer(read_buffer_, Message::HeaderLength),
-              [this, func](std::error_code error, std::size_t length) {
-                if (error) {
+              socket_, asio::buffer(read_buffer_, header.Length()),
+              [this, attachment](std::error_code error, std::size_t length) {
+                if (error || failed_) {
+                  Fail();
                   return;
                 }
-                Reader reader(read_buffer_, length);
-                asio::async_read(
-                    socket_, asio::buffer(read_buffer_, reader.Length()),
-                    [this, func](std::error_code error, std::size_t length) {
-                      if (error) {
-                        return;
-                      }
-                      Reader reader(read_buffer_, length, false);
-                      if constexpr (std::is_same_v<RType, void>) {
-                        func();
-                      } else {
-                        RType result;
-                        reader >> result;
-                        func(result);
-                      }
-                      lock_.unlock();
-                    });
+                Receive(length, attachment);
               });
         });
   }
 
+  void Receive(std::size_t length, uint64_t attachment) {
+    const auto& sink = waiting_.front()->sink;
+    if (!attachment) {
+      // an empty region still lands in the sink
+      Finish(length,
+             sink ? std::optional<FileRegion>(
+                        FileRegion{sink->fd, sink->offset, 0})
+                  : std::nullopt,
+             false);
+      return;
+    }
+    // the attachment can not be skipped on the stream, so the connection is
+    // given up if there is nowhere to put it
+    if (sink && attachment > sink->length) {
+      Fail();
+      return;
+    }
+    FileRegion download{sink ? sink->fd : CreateTempFile(),
+                        sink ? sink->offset : 0, attachment};
+    if (download.fd < 0) {
+      Fail();
+      return;
+    }
+    bool temporary = !sink;
+    AsyncReceiveFile(
+        socket_, download,
+        [this, length, download, temporary](std::error_code error) {
+          if (error || failed_) {
+            if (temporary) {
+              close(download.fd);
+            }
+            Fail();
+            return;
+          }
+          Finish(length, download, temporary);
+        });
+  }
+
+  void Finish(std::size_t length, std::optional<FileRegion> download,
+              bool temporary) {
+    auto request = std::move(waiting_.front());
+    waiting_.pop_front();
+    if (request->trace_id) {
+      // the response may be read before the write completion ran
+      uint64_t sent = request->sent ? request->sent : request->begin;
+      Tracer::Instance().Record(request->trace_id, "wait", sent,
+                                Tracer::Now());
+    }
+    Reader reader(read_buffer_, length, false);
+    if (download) {
+      reader.SetFileRegion(*download);
+    }
+    request->finish(reader);
+    if (temporary) {
+      close(download->fd);
+    }
+    if (request->trace_id) {
+      Tracer::Instance().Record(request->trace_id, "call", request->begin,
+                                Tracer::Now());
+    }
+    reading_ = false;
+    Read();
+  }
+
+  // a call that can not complete closes the connection, func is not run for
+  // it nor for any other pending or later call
+  void Fail() {
+    failed_ = true;
+    socket_.close();
+    requests_.clear();
+    sending_.clear();
+    waiting_.clear();
+  }
+
+  // only touched on the io thread
+  std::deque<std::shared_ptr<Request>> requests_;  // not written yet
+  std::vector<std::shared_ptr<Request>> sending_;  // in write_buffer_
+  std::deque<std::shared_ptr<Request>> waiting_;   // for their response
+  bool connected_ = false;
+  bool failed_ = false;
+  bool writing_ = false;
+  bool reading_ = false;
   char read_buffer_[Message::MaxLength];
   std::string write_buffer_;
-  std::mutex lock_;  // manage the buffer
 
   // network
   asio::ip::tcp::endpoint endpoint_;
@@ -96,4 +287,4 @@ class RpcClient {
   std::thread work_thread_;
   asio::executor_work_guard<asio::io_context::executor_type> work_guard_;
 };
-}  // namespace tinyrpc
\ No newline at end of file
+}  // namespace tinyrpc
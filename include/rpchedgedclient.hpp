@@ -0,0 +1,205 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "rpcclient.hpp"
+
+namespace tinyrpc {
+
+// client over several replicas of the same service, a HedgedCall sends a
+// duplicate request to a second replica if the first one has not replied
+// within the given percentile of recent latency, the first reply wins
+class RpcHedgedClient {
+ public:
+  RpcHedgedClient(
+      const std::vector<std::pair<std::string, uint16_t>>& endpoints,
+      double percentile = 0.95, double budget = 0.1)
+      : percentile_(percentile),
+        budget_(budget),
+        work_guard_(io_context_.get_executor()) {
+    for (const auto& [ip, port] : endpoints) {
+      replicas_.push_back(std::make_unique<Replica>(ip, port));
+    }
+  }
+  RpcHedgedClient(const RpcHedgedClient& oth) = delete;
+  RpcHedgedClient& operator=(const RpcHedgedClient& oth) = delete;
+  ~RpcHedgedClient() { Stop(); }
+
+  void Start() {
+    for (auto& replica : replicas_) {
+      replica->client.Start();
+    }
+    work_thread_ = std::thread([this]() { io_context_.run(); });
+  }
+
+  void Stop() {
+    if (!io_context_.stopped()) {
+      io_context_.stop();
+    }
+    if (work_thread_.joinable()) {
+      work_thread_.join();
+    }
+    for (auto& replica : replicas_) {
+      replica->client.Stop();
+    }
+  }
+
+  // never hedged, for methods that are not idempotent
+  template <typename RType, typename... Types, typename F>
+  void Call(const std::string& name, F func, Types... args) {
+    CallImpl<RType>(false, name, func, args...);
+  }
+
+  // only for idempotent methods, the request may be executed twice
+  template <typename RType, typename... Types, typename F>
+  void HedgedCall(const std::string& name, F func, Types... args) {
+    CallImpl<RType>(true, name, func, args...);
+  }
+
+  std::size_t HedgeCount() const { return hedges_; }
+
+ private:
+  static constexpr std::size_t LatencyWindow = 256;
+
+  struct Replica {
+    Replica(const std::string& ip, uint16_t port) : client(ip, port) {}
+    RpcClient client;
+    std::atomic<std::size_t> outstanding{0};
+  };
+
+  struct CallState {
+    CallState(asio::io_context& io_context) : timer(io_context) {}
+    std::atomic<bool> done{false};
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    asio::steady_timer timer;
+  };
+
+  template <typename RType, typename... Types, typename F>
+  void CallImpl(bool hedge, const std::string& name, F func, Types... args) {
+    auto state = std::make_shared<CallState>(io_context_);
+    // the loser still runs this to release its replica, but not func
+    auto complete = [this, state, func](std::size_t index, auto&... result) {
+      --replicas_[index]->outstanding;
+      if (state->done.exchange(true)) {
+        return;
+      }
+      Record(std::chrono::steady_clock::now() - state->start);
+      asio::post(io_context_, [state]() { state->timer.cancel(); });
+      func(result...);
+    };
+
+    std::size_t primary = Pick(replicas_.size());
+    Send<RType>(primary, complete, name, args...);
+    ++calls_;
+
+    if (!hedge || replicas_.size() < 2) {
+      return;
+    }
+    auto delay = HedgeDelay();
+    if (!delay) {
+      return;
+    }
+    // the timer is only touched on io_context_'s thread, where complete
+    // cancels it, and Send does not block that thread as RpcClient::Call
+    // only queues the request
+    asio::post(io_context_, [=]() {
+      if (state->done) {
+        return;
+      }
+      state->timer.expires_after(*delay);
+      state->timer.async_wait([=](std::error_code error) {
+        if (error || state->done || !TakeBudget()) {
+          return;
+        }
+        Send<RType>(Pick(primary), complete, name, args...);
+      });
+    });
+  }
+
+  template <typename RType, typename... Types, typename F>
+  void Send(std::size_t index, F complete, const std::string& name,
+            Types... args) {
+    ++replicas_[index]->outstanding;
+    replicas_[index]->client.Call<RType>(
+        name, [=](auto&... result) { complete(index, result...); }, args...);
+  }
+
+  // the replica with the fewest outstanding requests, ties go to the one
+  // listed first, requests pipelined behind others wait for them
+  std::size_t Pick(std::size_t exclude) const {
+    std::size_t best = replicas_.size();
+    for (std::size_t i = 0; i < replicas_.size(); ++i) {
+      if (i == exclude) {
+        continue;
+      }
+      if (best == replicas_.size() ||
+          replicas_[i]->outstanding < replicas_[best]->outstanding) {
+        best = i;
+      }
+    }
+    return best;
+  }
+
+  bool TakeBudget() {
+    std::size_t hedges = hedges_;
+    do {
+      if (hedges + 1 > budget_ * calls_) {
+        return false;
+      }
+    } while (!hedges_.compare_exchange_weak(hedges, hedges + 1));
+    return true;
+  }
+
+  void Record(std::chrono::steady_clock::duration latency) {
+    std::lock_guard<std::mutex> lock(latency_lock_);
+    if (latencies_.size() < LatencyWindow) {
+      latencies_.push_back(latency);
+    } else {
+      latencies_[next_latency_] = latency;
+    }
+    next_latency_ = (next_latency_ + 1) % LatencyWindow;
+  }
+
+  std::optional<std::chrono::steady_clock::duration> HedgeDelay() {
+    std::vector<std::chrono::steady_clock::duration> latencies;
+    {
+      std::lock_guard<std::mutex> lock(latency_lock_);
+      latencies = latencies_;
+    }
+    if (latencies.empty()) {
+      return std::nullopt;
+    }
+    auto nth = latencies.begin() +
+               std::min<std::size_t>(percentile_ * latencies.size(),
+                                     latencies.size() - 1);
+    std::nth_element(latencies.begin(), nth, latencies.end());
+    return *nth;
+  }
+
+  double percentile_;
+  double budget_;  // max hedges per call
+  std::atomic<std::size_t> calls_{0};
+  std::atomic<std::size_t> hedges_{0};
+
+  std::vector<std::chrono::steady_clock::duration> latencies_;
+  std::size_t next_latency_ = 0;
+  std::mutex latency_lock_;  // manage the latency window
+
+  // timers for hedging
+  asio::io_context io_context_;
+  std::thread work_thread_;
+  asio::executor_work_guard<asio::io_context::executor_type> work_guard_;
+
+  // destroyed first, pending callbacks hold timers of io_context_
+  std::vector<std::unique_ptr<Replica>> replicas_;
+};
+
+}  // namespace tinyrpc
@@ -1,12 +1,87 @@
 #pragma once
 
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <vector>
 
 #include "asio.hpp"
 #include "message.hpp"
+#include "trace.hpp"
+#include "tracer.hpp"
+#include "zerocopy.hpp"
 
 namespace tinyrpc {
 
+// delivers an encoded response and the file region following it
+using Reply = std::function<void(std::string, std::optional<FileRegion>)>;
+
+// taken as the last parameter by a handler that replies after it returns,
+// such a handler returns void and the connection goes on reading meanwhile
+// responses still leave the connection in request order
+template <typename RType>
+class Responder {
+ public:
+  Responder() = default;
+
+  // may be called from any thread, later calls are ignored, a responder
+  // dropped without a call sends an empty response, one made by
+  // RpcServer::Call without defer does nothing
+  template <typename... Args>
+  void operator()(const Args&... result) const {
+    static_assert(sizeof...(Args) == (std::is_void_v<RType> ? 0 : 1),
+                  "reply with exactly the result of the method");
+    if (!state_ || !state_->reply || state_->done.exchange(true)) {
+      return;
+    }
+    Writer writer;
+    writer.SetTraceId(state_->trace_id);
+    static_cast<void>((writer << ... << result));
+    state_->reply(writer.GetString(), writer.GetFileRegion());
+  }
+
+ private:
+  friend class RpcServer;
+
+  struct State {
+    State(uint64_t trace_id, Reply&& reply)
+        : trace_id(trace_id), reply(std::move(reply)) {}
+    ~State() {
+      if (!done && reply) {
+        Writer writer;
+        writer.SetTraceId(trace_id);
+        reply(writer.GetString(), std::nullopt);
+      }
+    }
+    uint64_t trace_id;
+    Reply reply;
+    std::atomic<bool> done{false};
+  };
+
+  Responder(uint64_t trace_id, Reply&& reply)
+      : state_(std::make_shared<State>(trace_id, std::move(reply))) {}
+
+  std::shared_ptr<State> state_;
+};
+
+namespace {
+template <typename T>
+struct is_responder : std::false_type {};
+template <typename T>
+struct is_responder<Responder<T>> : std::true_type {};
+
+template <typename... Types>
+constexpr bool is_async_v = false;
+template <typename T, typename... Types>
+constexpr bool is_async_v<T, Types...> = is_responder<
+    std::tuple_element_t<sizeof...(Types), std::tuple<T, Types...>>>::value;
+}  // namespace
+
 class RpcServer {
  public:
   RpcServer(uint16_t port)
@@ -32,66 +107,129 @@ class RpcServer {
 
   template <typename F>
   void Register(const std::string& name, F func) {
-    handlers_[name] = std::bind(&RpcServer::InvokeProxy<F>, this, func,
-                                std::placeholders::_1);
+    Publish(name, std::bind(&RpcServer::InvokeProxy<F>, this, func,
+                            std::placeholders::_1, std::placeholders::_2,
+                            std::placeholders::_3));
   }
   template <typename F, typename S>
   void Register(const std::string& name, S* obj, F func) {
-    handlers_[name] = std::bind(&RpcServer::InvokeProxy<F, S>, this, func, obj,
-                                std::placeholders::_1);
+    Publish(name, std::bind(&RpcServer::InvokeProxy<F, S>, this, func, obj,
+                            std::placeholders::_1, std::placeholders::_2,
+                            std::placeholders::_3));
   }
 
-  void UnRegister(const std::string& name) {
-    if (handlers_.count(name)) {
-      handlers_.erase(name);
+  // once Register replaced a handler or UnRegister removed it, the io thread
+  // does not call it any more, so an object it was bound to may be deleted,
+  // unless this is called from a handler, RpcServer::Call on other threads
+  // and Responders already handed out are not covered
+  void UnRegister(const std::string& name) { Publish(name, nullptr); }
+
+  // a request whose file region is larger closes its connection, the
+  // region is written to a temporary file before the handler runs
+  void SetMaxAttachment(uint64_t length) { max_attachment_ = length; }
+
+  // append every request frame received from now on to a trace file
+  bool StartCapture(const std::string& path) {
+    auto capture = std::make_shared<TraceWriter>(path);
+    if (!*capture) {
+      return false;
     }
+    std::atomic_store(&capture_, std::move(capture));
+    capturing_.store(true, std::memory_order_release);
+    return true;
   }
 
-  std::string Call(const std::string& name, Reader&& reader) {
-    return handlers_[name](std::move(reader));
+  // the trace file is complete once this returns, unless it is called from
+  // a handler or while the server is not running, returns the number of
+  // frames dropped because the writer fell behind
+  std::size_t StopCapture() {
+    capturing_.store(false, std::memory_order_release);
+    auto capture =
+        std::atomic_exchange(&capture_, std::shared_ptr<TraceWriter>());
+    if (!capture) {
+      return 0;
+    }
+    // the io thread may still append the frames of the read it handles
+    Quiesce();
+    return capture->Dropped();
+  }
+
+  // returns false if the handler replies later through the Reply made by
+  // defer, otherwise the response is in writer (empty if there is no such
+  // method)
+  bool Call(const std::string& name, Reader&& reader, Writer& writer,
+            const std::function<Reply()>& defer = nullptr) {
+    return Call(*std::atomic_load(&handlers_), name, std::move(reader),
+                writer, defer);
   }
 
  private:
   template <typename F>
-  std::string InvokeProxy(F func, Reader&& reader) {
-    return Invoke(func, std::move(reader));
+  bool InvokeProxy(F func, Reader&& reader, Writer& writer,
+                   const std::function<Reply()>& defer) {
+    return Invoke(func, std::move(reader), writer, defer);
   }
   template <typename F, typename S>
-  std::string InvokeProxy(F func, S* obj, Reader&& reader) {
-    return Invoke(func, obj, std::move(reader));
+  bool InvokeProxy(F func, S* obj, Reader&& reader, Writer& writer,
+                   const std::function<Reply()>& defer) {
+    return Invoke(func, obj, std::move(reader), writer, defer);
   }
 
   template <typename RType, typename... Types>
-  std::string Invoke(std::function<RType(Types...)> func, Reader&& reader) {
+  bool Invoke(std::function<RType(Types...)> func, Reader&& reader,
+              Writer& writer, const std::function<Reply()>& defer) {
     std::tuple<Types...> args;
     auto index_sequence =
         std::make_index_sequence<std::tuple_size_v<decltype(args)>>();
-    ReadArgs(std::move(reader), args, index_sequence);
-    if constexpr (std::is_same_v<void, RType>) {
-      InvokeImpl(func, args, index_sequence);
-      return Writer().GetString();
+    Tracer::Trace("decode args", [&]() {
+      ReadArgs(std::move(reader), args, index_sequence);
+    });
+    if constexpr (is_async_v<Types...>) {
+      static_assert(std::is_void_v<RType>,
+                    "an asynchronous handler replies through its Responder");
+      using ResponderType = std::tuple_element_t<sizeof...(Types) - 1,
+                                                 std::tuple<Types...>>;
+      std::get<sizeof...(Types) - 1>(args) =
+          ResponderType(writer.TraceId(), defer ? defer() : Reply());
+      Tracer::Trace("handler",
+                    [&]() { InvokeImpl(func, args, index_sequence); });
+      return false;
+    } else if constexpr (std::is_same_v<void, RType>) {
+      Tracer::Trace("handler",
+                    [&]() { InvokeImpl(func, args, index_sequence); });
     } else {
-      auto result = InvokeImpl(func, args, index_sequence);
-      return (Writer() << result).GetString();
+      auto result = Tracer::Trace(
+          "handler", [&]() { return InvokeImpl(func, args, index_sequence); });
+      Tracer::Trace("encode", [&]() { writer << result; });
     }
+    return true;
   }
   template <typename RType, typename... Types>
-  std::string Invoke(RType (*func)(Types...), Reader&& reader) {
-    return Invoke(std::function<RType(Types...)>(func), std::move(reader));
+  bool Invoke(RType (*func)(Types...), Reader&& reader, Writer& writer,
+              const std::function<Reply()>& defer) {
+    return Invoke(std::function<RType(Types...)>(func), std::move(reader),
+                  writer, defer);
   }
   template <typename RType, typename C, typename S, typename... Types>
-  std::string Invoke(RType (C::*func)(Types...), S* obj, Reader&& reader) {
+  bool Invoke(RType (C::*func)(Types...), S* obj, Reader&& reader,
+              Writer& writer, const std::function<Reply()>& defer) {
     std::function<RType(Types...)> wrapper = [=](Types... args) -> RType {
       return (obj->*func)(args...);
     };
-    return Invoke(wrapper, std::move(reader));
+    return Invoke(wrapper, std::move(reader), writer, defer);
   }
 
   template <typename... Types, std::size_t... I>
   void ReadArgs(Reader&& reader, std::tuple<Types...>& args,
                 std::index_sequence<I...>) {
-    static_cast<void>((reader >> ... >> std::get<I>(args)));
+    static_cast<void>((ReadArg(reader, std::get<I>(args)), ...));
+  }
+  template <typename T>
+  void ReadArg(Reader& reader, T& arg) {
+    reader >> arg;
   }
+  template <typename T>
+  void ReadArg(Reader& reader, Responder<T>& arg) {}
 
   template <typename RType, typename... Types, std::size_t... I>
   RType InvokeImpl(std::function<RType(Types...)> func,
@@ -105,61 +243,450 @@ class RpcServer {
           if (error) {
             return;
           }
-          std::make_shared<Connection>(std::move(socket), *this)->Start();
+          std::make_shared<Connection>(std::move(socket), *this,
+                                       next_connection_++)
+              ->Start();
           Listen();
         });
   }
 
-  std::unordered_map<std::string, std::function<std::string(Reader&&)>>
-      handlers_;
+  using Handler = std::function<bool(Reader&&, Writer&,
+                                     const std::function<Reply()>&)>;
+  using HandlerTable = std::unordered_map<std::string, Handler>;
+
+  static bool Call(const HandlerTable& handlers, const std::string& name,
+                   Reader&& reader, Writer& writer,
+                   const std::function<Reply()>& defer) {
+    auto iter = handlers.find(name);
+    if (iter == handlers.end()) {
+      return true;
+    }
+    return iter->second(std::move(reader), writer, defer);
+  }
+
+  // copy on write: writers are serialized and publish a new table, the old
+  // one is freed by its last reader
+  // std::atomic_load on a shared_ptr takes a lock from a global pool in
+  // libstdc++, so a connection keeps the table it loaded last and only
+  // reloads it after version_ moved, dispatch itself is one atomic load
+  void Publish(const std::string& name, Handler handler) {
+    bool replaced;
+    {
+      std::lock_guard<std::mutex> lock(handlers_lock_);
+      auto handlers =
+          std::make_shared<HandlerTable>(*std::atomic_load(&handlers_));
+      replaced = handlers->count(name);
+      if (handler) {
+        (*handlers)[name] = std::move(handler);
+      } else {
+        handlers->erase(name);
+      }
+      std::atomic_store(
+          &handlers_,
+          std::shared_ptr<const HandlerTable>(std::move(handlers)));
+      version_.fetch_add(1, std::memory_order_release);
+    }
+    // a dispatch may still be running with the old table, the next one
+    // reloads it
+    if (replaced) {
+      Quiesce();
+    }
+  }
+
+  // wait until the io thread is done with what it was handling, skipped on
+  // the io thread itself and while the server is not running
+  void Quiesce() {
+    if (!work_thread_.joinable() || io_context_.stopped() ||
+        io_context_.get_executor().running_in_this_thread()) {
+      return;
+    }
+    auto idle = std::make_shared<std::promise<void>>();
+    auto future = idle->get_future();
+    asio::post(io_context_, [idle]() { idle->set_value(); });
+    while (future.wait_for(std::chrono::milliseconds(10)) !=
+               std::future_status::ready &&
+           !io_context_.stopped()) {
+    }
+  }
+
+  // like handlers_, capture_ is only loaded while capturing_ is set, so a
+  // read takes no lock when nothing is captured
+  std::shared_ptr<TraceWriter> Capture() const {
+    if (!capturing_.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+    return std::atomic_load(&capture_);
+  }
+
+  // refresh a snapshot of handlers_ taken at version
+  void Load(std::shared_ptr<const HandlerTable>& handlers,
+            uint64_t& version) const {
+    uint64_t current = version_.load(std::memory_order_acquire);
+    if (!handlers || version != current) {
+      handlers = std::atomic_load(&handlers_);
+      version = current;
+    }
+  }
+
+  std::shared_ptr<const HandlerTable> handlers_ =
+      std::make_shared<const HandlerTable>();
+  std::atomic<uint64_t> version_{0};  // of handlers_
+  std::mutex handlers_lock_;  // serialize writers of handlers_
+  // only appended to from the io thread, the writer's single producer
+  std::shared_ptr<TraceWriter> capture_;
+  std::atomic<bool> capturing_{false};  // capture_ is set
+  std::atomic<uint64_t> max_attachment_{uint64_t(1) << 30};
   // for network
   asio::io_context io_context_;
   std::thread work_thread_;
   asio::ip::tcp::acceptor acceptor_;
+  uint32_t next_connection_ = 0;
 
   class Connection : public std::enable_shared_from_this<Connection> {
    public:
-    Connection(asio::ip::tcp::socket&& socket, RpcServer& server)
-        : socket_(std::move(socket)), server_(server) {}
-    ~Connection() { socket_.close(); }
+    Connection(asio::ip::tcp::socket&& socket, RpcServer& server,
+               uint32_t id)
+        : socket_(std::move(socket)), server_(server), id_(id) {}
+    ~Connection() {
+      socket_.close();
+      for (auto& output : queue_) {
+        output.Close();
+      }
+      for (auto& [seq, output] : waiting_) {
+        output.Close();
+      }
+    }
+
+    void Start() { Read(); }
+
+   private:
+    static constexpr std::size_t ReadBufferLength = 1 << 16;
+    static_assert(
+        ReadBufferLength >= Message::HeaderLength + Message::MaxLength,
+        "read buffer must hold at least one complete frame");
 
-    void Start() {
+    // requests read but not answered yet, e.g. by a Responder
+    static constexpr uint64_t MaxOutstanding = 1024;
+
+    enum class Next { Read, Receive, Error };
+
+    // a received file region, closed once neither the handler nor a pending
+    // reply can use it any more, unless the response took it over
+    struct Upload {
+      Upload(const FileRegion& region) : region(region) {}
+      Upload(const Upload& oth) = delete;
+      Upload& operator=(const Upload& oth) = delete;
+      ~Upload() {
+        if (region.fd >= 0) {
+          close(region.fd);
+        }
+      }
+      // the response's region is closed by its Output
+      void Release(const FileRegion& response) {
+        if (response.fd == region.fd) {
+          region.fd = -1;
+        }
+      }
+      FileRegion region;
+    };
+
+    // a response ready to be written, the server owns its file region
+    struct Output {
+      void Close() {
+        if (region) {
+          close(region->fd);
+        }
+      }
+      std::string data;
+      std::optional<FileRegion> region;
+      uint64_t trace_id;
+    };
+
+    void Read() {
       auto self{shared_from_this()};
-      asio::async_read(
-          socket_, asio::buffer(read_buffer_, Message::HeaderLength),
+      socket_.async_read_some(
+          asio::buffer(read_buffer_ + read_length_,
+                       ReadBufferLength - read_length_),
           [this, self](std::error_code error, std::size_t length) {
             if (error) {
               return;
             }
-            Reader reader(read_buffer_, length);
-            asio::async_read(
-                socket_, asio::buffer(read_buffer_, reader.Length()),
-                [this, self](std::error_code error, std::size_t length) {
-                  if (error) {
-                    return;
-                  }
-                  Reader reader(read_buffer_, length, false);
-                  std::string name;
-                  reader >> name;
-                  write_buffer_ =
-                      std::move(server_.Call(name, std::move(reader)));
-                  asio::async_write(
-                      socket_, asio::buffer(write_buffer_),
-                      [this, self](std::error_code error, std::size_t length) {
-                        if (error) {
-                          return;
-                        }
-                        Start();
-                      });
-                });
+            read_length_ += length;
+            read_time_ = Tracer::Instance().Enabled() ? Tracer::Now() : 0;
+            Process();
           });
     }
 
-   private:
+    void Process() {
+      Next next = Dispatch();
+      Write();
+      switch (next) {
+        case Next::Read:
+          if (Backlogged()) {
+            read_paused_ = true;
+          } else {
+            Read();
+          }
+          break;
+        case Next::Receive:
+          ReceiveFile();
+          break;
+        case Next::Error:
+          socket_.close();
+          break;
+      }
+    }
+
+    // handle every complete frame in read_buffer_ up to one that carries a
+    // file region, the trailing partial frame is kept for the next read
+    Next Dispatch() {
+      auto capture = server_.Capture();
+      server_.Load(handlers_, version_);
+      std::size_t offset = 0;
+      Next next = Next::Read;
+      while (read_length_ - offset >= Message::HeaderLength) {
+        Reader header(read_buffer_ + offset, Message::HeaderLength);
+        if (!header || header.Length() > Message::MaxLength) {
+          next = Next::Error;
+          break;
+        }
+        std::size_t frame_length = Message::HeaderLength + header.Length();
+        if (read_length_ - offset < frame_length) {
+          break;
+        }
+        if (header.Attachment() > server_.max_attachment_) {
+          next = Next::Error;
+          break;
+        }
+        if (header.Attachment()) {
+          next = Next::Receive;
+          break;
+        }
+        Handle(offset, header, nullptr, capture.get());
+        offset += frame_length;
+      }
+      Consume(offset);
+      return next;
+    }
+
+    // dispatch the frame at offset, upload is the file region received
+    // after it, if any
+    // a frame is traced if the client traced it or the server samples it
+    void Handle(std::size_t offset, const Reader& header,
+                const std::shared_ptr<Upload>& upload, TraceWriter* capture) {
+      if (capture) {
+        uint32_t length = Message::HeaderLength + header.Length();
+        if (!header.Attachment()) {
+          capture->Append(id_, read_buffer_ + offset, length);
+        } else {  // see TraceRecord
+          std::string frame(read_buffer_ + offset, length);
+          std::memset(frame.data() + Message::AttachmentOffset, 0,
+                      sizeof(uint64_t));
+          capture->Append(id_, frame.data(), length, header.Attachment());
+        }
+      }
+      uint64_t trace_id = header.TraceId();
+      if (!trace_id) {
+        trace_id = Tracer::Instance().Sample();
+      }
+      Tracer::Current() = trace_id;
+      if (trace_id && read_time_) {
+        // waiting behind the frames before it in the same read, only known
+        // while this server samples too
+        Tracer::Instance().Record(trace_id, "queue", read_time_,
+                                  Tracer::Now());
+      }
+      Reader reader(read_buffer_ + offset + Message::HeaderLength,
+                    header.Length(), false);
+      if (upload) {
+        reader.SetFileRegion(upload->region);
+      }
+      std::string name;
+      Tracer::Trace("decode name", [&]() { reader >> name; });
+      uint64_t seq = next_seq_++;
+      Writer writer;
+      writer.SetTraceId(trace_id);
+      if (Call(*handlers_, name, std::move(reader), writer,
+               [this, seq, upload]() { return Defer(seq, upload); })) {
+        auto region = writer.GetFileRegion();
+        if (upload && region) {
+          upload->Release(*region);
+        }
+        Respond(seq, Output{writer.GetString(), region, trace_id});
+      }
+      Tracer::Current() = 0;
+    }
+
+    // the Reply of an asynchronous handler, it keeps the connection and the
+    // uploaded file alive
+    Reply Defer(uint64_t seq, const std::shared_ptr<Upload>& upload) {
+      auto self{shared_from_this()};
+      uint64_t trace_id = Tracer::Current();
+      return [self, seq, trace_id, upload](std::string data,
+                                           std::optional<FileRegion> region) {
+        asio::post(self->socket_.get_executor(),
+                   [self, seq, trace_id, upload, data = std::move(data),
+                    region]() {
+                     if (upload && region) {
+                       upload->Release(*region);
+                     }
+                     self->Respond(seq, Output{std::move(data), region,
+                                               trace_id});
+                     self->Write();
+                     self->Resume();
+                   });
+      };
+    }
+
+    // queue responses in request order, holding back those that complete
+    // before an earlier one
+    void Respond(uint64_t seq, Output&& output) {
+      if (seq != next_out_) {
+        waiting_.emplace(seq, std::move(output));
+        return;
+      }
+      queue_.push_back(std::move(output));
+      ++next_out_;
+      for (auto iter = waiting_.begin();
+           iter != waiting_.end() && iter->first == next_out_;
+           iter = waiting_.erase(iter)) {
+        queue_.push_back(std::move(iter->second));
+        ++next_out_;
+      }
+    }
+
+    // write everything queued in one go, up to and including the first
+    // response followed by a file region, which is then sent with sendfile
+    void Write() {
+      if (writing_ || queue_.empty()) {
+        return;
+      }
+      writing_ = true;
+      std::optional<FileRegion> region;
+      while (!queue_.empty() && !region) {
+        auto& output = queue_.front();
+        write_buffer_ += output.data;
+        if (output.trace_id) {
+          traced_.push_back(output.trace_id);
+        }
+        region = output.region;
+        queue_.pop_front();
+      }
+      auto self{shared_from_this()};
+      uint64_t begin = traced_.empty() ? 0 : Tracer::Now();
+      asio::async_write(
+          socket_, asio::buffer(write_buffer_),
+          [this, self, begin, region](std::error_code error,
+                                      std::size_t length) {
+            if (error) {
+              if (region) {
+                close(region->fd);
+              }
+              return;
+            }
+            if (!traced_.empty()) {
+              uint64_t end = Tracer::Now();
+              for (auto trace_id : traced_) {
+                Tracer::Instance().Record(trace_id, "write", begin, end);
+              }
+              traced_.clear();
+            }
+            write_buffer_.clear();
+            if (!region) {
+              Written();
+              return;
+            }
+            AsyncSendFile(socket_, *region,
+                          [this, self, region](std::error_code error) {
+                            close(region->fd);
+                            if (error) {
+                              return;
+                            }
+                            Written();
+                          });
+          });
+    }
+
+    void Written() {
+      writing_ = false;
+      Write();
+      Resume();
+    }
+
+    // stop reading while the client does not keep up with responses or too
+    // many are still outstanding, one read may still add a buffer's worth
+    bool Backlogged() const {
+      return (writing_ && !queue_.empty()) ||
+             next_seq_ - next_out_ > MaxOutstanding;
+    }
+
+    void Resume() {
+      if (read_paused_ && !Backlogged()) {
+        read_paused_ = false;
+        Read();
+      }
+    }
+
+    // receive the file region following the frame at the front of
+    // read_buffer_ into a temporary file, then dispatch the frame, a failure
+    // closes the connection
+    void ReceiveFile() {
+      auto self{shared_from_this()};
+      Reader header(read_buffer_, Message::HeaderLength);
+      std::size_t frame_length = Message::HeaderLength + header.Length();
+      int fd = CreateTempFile();
+      if (fd < 0) {
+        socket_.close();
+        return;
+      }
+      auto upload = std::make_shared<Upload>(
+          FileRegion{fd, 0, header.Attachment()});
+      // the read may already have taken the start of the region
+      std::size_t buffered = std::min<uint64_t>(read_length_ - frame_length,
+                                                upload->region.length);
+      if (write(fd, read_buffer_ + frame_length, buffered) !=
+          static_cast<ssize_t>(buffered)) {
+        socket_.close();
+        return;
+      }
+      AsyncReceiveFile(
+          socket_,
+          FileRegion{fd, buffered, upload->region.length - buffered},
+          [this, self, upload, frame_length, buffered](std::error_code error) {
+            if (error) {
+              socket_.close();
+              return;
+            }
+            auto capture = server_.Capture();
+            server_.Load(handlers_, version_);
+            Handle(0, Reader(read_buffer_, Message::HeaderLength), upload,
+                   capture.get());
+            Consume(frame_length + buffered);
+            Process();
+          });
+    }
+
+    void Consume(std::size_t length) {
+      read_length_ -= length;
+      std::memmove(read_buffer_, read_buffer_ + length, read_length_);
+    }
+
     asio::ip::tcp::socket socket_;
-    char read_buffer_[Message::MaxLength];
+    char read_buffer_[ReadBufferLength];
+    std::size_t read_length_ = 0;
+    uint64_t read_time_ = 0;
+    bool read_paused_ = false;
+    uint64_t next_seq_ = 0;  // of the next request
+    uint64_t next_out_ = 0;  // of the next response to queue
+    std::map<uint64_t, Output> waiting_;
+    std::deque<Output> queue_;
+    bool writing_ = false;
     std::string write_buffer_;
+    std::vector<uint64_t> traced_;  // requests in write_buffer_ being traced
+    std::shared_ptr<const HandlerTable> handlers_;  // see RpcServer::Load
+    uint64_t version_ = 0;
     RpcServer& server_;
+    uint32_t id_;
   };
 };
 
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace tinyrpc {
+
+// trace file: a TraceHeader, then for each captured frame a TraceRecord
+// followed by the frame itself (message header included), native endian
+// the FileRegion a frame carries is not captured: the frame's header has its
+// attachment cleared so it still parses alone, the record keeps the length
+struct TraceHeader {
+  uint32_t identifier;
+  uint32_t version;
+};
+
+struct TraceRecord {
+  uint64_t timestamp;  // steady clock, nanoseconds
+  uint32_t connection;
+  uint32_t length;
+  uint64_t attachment;  // bytes of the FileRegion that followed the frame
+};
+
+class TraceWriter {
+ public:
+  static constexpr uint32_t Magic = 0x74727063;  // "trpc"
+  // 3: 24 byte message header, 4: attachment in TraceRecord
+  static constexpr uint32_t Version = 4;
+
+  TraceWriter(const std::string& path, std::size_t capacity = 1 << 22)
+      : buffer_(capacity), file_(std::fopen(path.c_str(), "wb")) {
+    if (!file_) {
+      return;
+    }
+    TraceHeader header{Magic, Version};
+    std::fwrite(&header, sizeof(header), 1, file_);
+    flush_thread_ = std::thread([this]() { Flush(); });
+  }
+  TraceWriter(const TraceWriter& oth) = delete;
+  TraceWriter& operator=(const TraceWriter& oth) = delete;
+  ~TraceWriter() {
+    stop_ = true;
+    if (flush_thread_.joinable()) {
+      flush_thread_.join();
+    }
+    if (file_) {
+      std::fclose(file_);
+    }
+  }
+
+  operator bool() const { return file_ != nullptr; }
+
+  std::size_t Dropped() const { return dropped_; }
+
+  // single producer, never blocks: the frame is dropped if the buffer is full
+  void Append(uint32_t connection, const char* frame, uint32_t length,
+              uint64_t attachment = 0) {
+    std::size_t size = sizeof(TraceRecord) + Align(length);
+    std::size_t tail = tail_.load(std::memory_order_relaxed);
+    std::size_t head = head_.load(std::memory_order_acquire);
+    if (!file_ || size > buffer_.size() - (tail - head)) {
+      ++dropped_;
+      return;
+    }
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    TraceRecord record{
+        static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(now).count()),
+        connection, length, attachment};
+    Copy(tail, reinterpret_cast<const char*>(&record), sizeof(record));
+    Copy(tail + sizeof(record), frame, length);
+    tail_.store(tail + size, std::memory_order_release);
+  }
+
+  // records start on 8 byte boundaries so the mapped file can be read in place
+  static std::size_t Align(std::size_t length) {
+    return (length + 7) & ~std::size_t{7};
+  }
+
+ private:
+  void Copy(std::size_t pos, const char* data, std::size_t length) {
+    std::size_t offset = pos % buffer_.size();
+    std::size_t first = std::min(length, buffer_.size() - offset);
+    std::memcpy(buffer_.data() + offset, data, first);
+    std::memcpy(buffer_.data(), data + first, length - first);
+  }
+
+  void Flush() {
+    while (true) {
+      bool stop = stop_;
+      std::size_t head = head_.load(std::memory_order_relaxed);
+      std::size_t tail = tail_.load(std::memory_order_acquire);
+      if (head == tail) {
+        if (stop) {
+          break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        continue;
+      }
+      std::size_t offset = head % buffer_.size();
+      std::size_t length = std::min(tail - head, buffer_.size() - offset);
+      std::fwrite(buffer_.data() + offset, 1, length, file_);
+      head_.store(head + length, std::memory_order_release);
+    }
+    std::fflush(file_);
+  }
+
+  std::vector<char> buffer_;
+  std::atomic<std::size_t> head_{0};  // consumed by Flush
+  std::atomic<std::size_t> tail_{0};  // produced by Append
+  std::atomic<std::size_t> dropped_{0};
+  std::atomic<bool> stop_{false};
+  std::FILE* file_;
+  std::thread flush_thread_;
+};
+
+class TraceReader {
+ public:
+  struct Frame {
+    const TraceRecord* record;
+    const char* data;
+  };
+
+  TraceReader(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size >= 0 &&
+        static_cast<std::size_t>(st.st_size) >= sizeof(TraceHeader)) {
+      void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data != MAP_FAILED) {
+        data_ = static_cast<const char*>(data);
+        length_ = st.st_size;
+      }
+    }
+    close(fd);
+    if (data_) {
+      auto header = reinterpret_cast<const TraceHeader*>(data_);
+      if (header->identifier != TraceWriter::Magic ||
+          header->version != TraceWriter::Version) {
+        munmap(const_cast<char*>(data_), length_);
+        data_ = nullptr;
+      }
+    }
+  }
+  TraceReader(const TraceReader& oth) = delete;
+  TraceReader& operator=(const TraceReader& oth) = delete;
+  ~TraceReader() {
+    if (data_) {
+      munmap(const_cast<char*>(data_), length_);
+    }
+  }
+
+  operator bool() const { return data_ != nullptr; }
+
+  // next frame in the file, false at the end or on a truncated record
+  bool Next(Frame& frame) {
+    if (!data_ || length_ - offset_ < sizeof(TraceRecord)) {
+      return false;
+    }
+    auto record = reinterpret_cast<const TraceRecord*>(data_ + offset_);
+    if (length_ - offset_ - sizeof(TraceRecord) < record->length) {
+      return false;
+    }
+    frame.record = record;
+    frame.data = data_ + offset_ + sizeof(TraceRecord);
+    offset_ += std::min(
+        sizeof(TraceRecord) + TraceWriter::Align(record->length),
+        length_ - offset_);
+    return true;
+  }
+
+  void Rewind() { offset_ = sizeof(TraceHeader); }
+
+ private:
+  const char* data_ = nullptr;
+  std::size_t length_ = 0;
+  std::size_t offset_ = sizeof(TraceHeader);
+};
+
+}  // namespace tinyrpc
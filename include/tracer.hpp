@@ -0,0 +1,214 @@
+#pragma once
+
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace tinyrpc {
+
+// per-request spans, kept in a fixed ring per thread and exported in the
+// chrome trace event format (chrome://tracing, ui.perfetto.dev)
+// the trace id travels in the message header, so client and server spans of
+// one call share it
+class Tracer {
+ public:
+  static constexpr std::size_t RingLength = 1 << 12;
+
+  static Tracer& Instance() {
+    static Tracer tracer;
+    return tracer;
+  }
+
+  // the request being handled on this thread, 0 if it is not traced
+  static uint64_t& Current() {
+    thread_local uint64_t trace_id = 0;
+    return trace_id;
+  }
+
+  static uint64_t Now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  // time func as a span of the current request
+  template <typename F>
+  static auto Trace(const char* name, F func) {
+    Scope scope(name);
+    return func();
+  }
+
+  class Scope {
+   public:
+    Scope(const char* name)
+        : trace_id_(Current()), name_(name), begin_(trace_id_ ? Now() : 0) {}
+    Scope(const Scope& oth) = delete;
+    Scope& operator=(const Scope& oth) = delete;
+    ~Scope() {
+      if (trace_id_) {
+        Instance().Record(trace_id_, name_, begin_, Now());
+      }
+    }
+
+   private:
+    uint64_t trace_id_;
+    const char* name_;
+    uint64_t begin_;
+  };
+
+  // trace one request in every n started on each thread, 0 turns it off
+  void SetSampleRate(uint32_t n) {
+    sample_rate_.store(n, std::memory_order_relaxed);
+  }
+
+  // false while sampling is off, timestamps only needed by spans can be
+  // skipped then
+  bool Enabled() const {
+    return sample_rate_.load(std::memory_order_relaxed) != 0;
+  }
+
+  // a new trace id if this request is sampled, otherwise 0
+  uint64_t Sample() {
+    uint32_t n = sample_rate_.load(std::memory_order_relaxed);
+    if (!n) {
+      return 0;
+    }
+    thread_local uint32_t count = 0;
+    if (++count % n) {
+      return 0;
+    }
+    return static_cast<uint64_t>(getpid()) << 32 | ++next_id_;
+  }
+
+  // name must outlive the tracer, use a string literal
+  void Record(uint64_t trace_id, const char* name, uint64_t begin,
+              uint64_t end) {
+    LocalRing().Push(trace_id, name, begin, end);
+  }
+
+  // all spans still in the rings, in chrome trace event json
+  std::string Dump() {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+    bool first = true;
+    std::lock_guard<std::mutex> lock(rings_lock_);
+    for (const auto& ring : rings_) {
+      ring->ForEach([&](uint64_t trace_id, const char* name, uint64_t begin,
+                        uint64_t end) {
+        oss << (first ? "" : ",") << "\n{\"name\":\"" << name
+            << "\",\"cat\":\"tinyrpc\",\"ph\":\"X\",\"ts\":" << begin / 1e3
+            << ",\"dur\":" << (end - begin) / 1e3 << ",\"pid\":" << getpid()
+            << ",\"tid\":" << ring->tid << ",\"args\":{\"trace_id\":\""
+            << std::hex << trace_id << std::dec << "\"}}";
+        first = false;
+      });
+    }
+    oss << "\n]}\n";
+    return oss.str();
+  }
+
+ private:
+  Tracer() = default;
+
+  // single writer, readers skip a slot that is being overwritten
+  struct Ring {
+    struct Span {
+      std::atomic<uint64_t> sequence{0};  // 2 * index + 2 once written
+      std::atomic<uint64_t> trace_id;
+      std::atomic<const char*> name;
+      std::atomic<uint64_t> begin;
+      std::atomic<uint64_t> end;
+    };
+
+    Ring(uint32_t tid) : tid(tid) {}
+
+    void Push(uint64_t trace_id, const char* name, uint64_t begin,
+              uint64_t end) {
+      uint64_t index = head.load(std::memory_order_relaxed);
+      Span& span = spans[index % RingLength];
+      span.sequence.store(2 * index + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      span.trace_id.store(trace_id, std::memory_order_relaxed);
+      span.name.store(name, std::memory_order_relaxed);
+      span.begin.store(begin, std::memory_order_relaxed);
+      span.end.store(end, std::memory_order_relaxed);
+      span.sequence.store(2 * index + 2, std::memory_order_release);
+      head.store(index + 1, std::memory_order_release);
+    }
+
+    template <typename F>
+    void ForEach(F func) const {
+      uint64_t last = head.load(std::memory_order_acquire);
+      for (uint64_t index = last > RingLength ? last - RingLength : 0;
+           index < last; ++index) {
+        const Span& span = spans[index % RingLength];
+        if (span.sequence.load(std::memory_order_acquire) != 2 * index + 2) {
+          continue;
+        }
+        uint64_t trace_id = span.trace_id.load(std::memory_order_relaxed);
+        const char* name = span.name.load(std::memory_order_relaxed);
+        uint64_t begin = span.begin.load(std::memory_order_relaxed);
+        uint64_t end = span.end.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (span.sequence.load(std::memory_order_relaxed) != 2 * index + 2) {
+          continue;
+        }
+        func(trace_id, name, begin, end);
+      }
+    }
+
+    uint32_t tid;
+    std::atomic<uint64_t> head{0};
+    Span spans[RingLength];
+  };
+
+  // a ring outlives its thread so its spans can still be dumped, and is
+  // handed to the next thread that records, so there are never more rings
+  // than threads recording at the same time, their spans share its tid
+  Ring& LocalRing() {
+    struct Owner {
+      ~Owner() {
+        if (ring) {
+          Instance().Release(ring);
+        }
+      }
+      Ring* ring = nullptr;
+    };
+    thread_local Owner owner;
+    if (!owner.ring) {
+      owner.ring = Acquire();
+    }
+    return *owner.ring;
+  }
+
+  Ring* Acquire() {
+    std::lock_guard<std::mutex> lock(rings_lock_);
+    if (!free_rings_.empty()) {
+      Ring* ring = free_rings_.back();
+      free_rings_.pop_back();
+      return ring;
+    }
+    rings_.push_back(std::make_unique<Ring>(rings_.size() + 1));
+    return rings_.back().get();
+  }
+
+  void Release(Ring* ring) {
+    std::lock_guard<std::mutex> lock(rings_lock_);
+    free_rings_.push_back(ring);
+  }
+
+  std::atomic<uint32_t> sample_rate_{0};
+  std::atomic<uint32_t> next_id_{0};
+  std::vector<std::unique_ptr<Ring>> rings_;
+  std::vector<Ring*> free_rings_;  // of exited threads
+  std::mutex rings_lock_;  // only taken to hand out a ring or to dump
+};
+
+}  // namespace tinyrpc
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <memory>
+#include <system_error>
+
+#include "asio.hpp"
+#include "message.hpp"
+
+namespace tinyrpc {
+
+// moving FileRegion attachments between a file and a socket without copying
+// them through user space, the socket is switched to non-blocking mode and
+// the reactor is only used to wait until it is ready again
+
+// an unnamed file to receive an attachment into, -1 on failure
+inline int CreateTempFile() {
+  return open(P_tmpdir, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+}
+
+namespace {
+constexpr std::size_t ChunkLength = 1 << 20;
+
+inline std::error_code LastError() {
+  return std::error_code(errno, std::system_category());
+}
+
+struct Pipe {
+  Pipe() {
+    if (pipe2(fds, O_CLOEXEC)) {
+      fds[0] = fds[1] = -1;
+    }
+  }
+  Pipe(const Pipe& oth) = delete;
+  Pipe& operator=(const Pipe& oth) = delete;
+  ~Pipe() {
+    if (fds[0] >= 0) {
+      close(fds[0]);
+      close(fds[1]);
+    }
+  }
+  int fds[2];
+};
+
+// sendfile(2) has no MSG_NOSIGNAL, SIGPIPE is blocked on this thread around
+// it and one it raised for a closed peer is consumed instead of killing the
+// process, unless the caller had blocked SIGPIPE itself
+// the signal may come with a partial count, so it is looked for either way
+inline ssize_t SendFile(int socket, int fd, off_t* offset, std::size_t length) {
+  sigset_t set, old, pending;
+  sigemptyset(&set);
+  sigaddset(&set, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &set, &old);
+  ssize_t n = sendfile(socket, fd, offset, length);
+  int error = errno;
+  if (!sigismember(&old, SIGPIPE) && !sigpending(&pending) &&
+      sigismember(&pending, SIGPIPE)) {
+    timespec timeout{0, 0};
+    sigtimedwait(&set, nullptr, &timeout);
+  }
+  pthread_sigmask(SIG_SETMASK, &old, nullptr);
+  errno = error;
+  return n;
+}
+
+template <typename Handler>
+void Complete(asio::ip::tcp::socket& socket, Handler handler,
+              std::error_code error) {
+  asio::post(socket.get_executor(), [handler, error]() { handler(error); });
+}
+
+template <typename Handler>
+void SendFileImpl(asio::ip::tcp::socket& socket, FileRegion region,
+                  Handler handler) {
+  while (region.length) {
+    off_t offset = region.offset;
+    ssize_t n = SendFile(socket.native_handle(), region.fd, &offset,
+                         std::min<uint64_t>(region.length, ChunkLength));
+    if (n > 0) {
+      region.offset += n;
+      region.length -= n;
+    } else if (n < 0 && errno == EINTR) {
+      continue;
+    } else if (n < 0 && errno == EAGAIN) {
+      socket.async_wait(asio::ip::tcp::socket::wait_write,
+                        [&socket, region, handler](std::error_code error) {
+                          if (error) {
+                            handler(error);
+                            return;
+                          }
+                          SendFileImpl(socket, region, handler);
+                        });
+      return;
+    } else {  // the file is shorter than the region
+      Complete(socket, handler,
+               n ? LastError() : std::make_error_code(std::errc::io_error));
+      return;
+    }
+  }
+  Complete(socket, handler, std::error_code());
+}
+
+template <typename Handler>
+void ReceiveFileImpl(asio::ip::tcp::socket& socket, std::shared_ptr<Pipe> pipe,
+                     int fd, uint64_t offset, uint64_t length,
+                     Handler handler) {
+  while (length) {
+    ssize_t n = splice(socket.native_handle(), nullptr, pipe->fds[1], nullptr,
+                       std::min<uint64_t>(length, ChunkLength),
+                       SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0 && errno == EAGAIN) {
+      socket.async_wait(
+          asio::ip::tcp::socket::wait_read,
+          [&socket, pipe, fd, offset, length, handler](std::error_code error) {
+            if (error) {
+              handler(error);
+              return;
+            }
+            ReceiveFileImpl(socket, pipe, fd, offset, length, handler);
+          });
+      return;
+    }
+    if (n <= 0) {  // the peer closed the connection
+      Complete(socket, handler,
+               n ? LastError() : std::make_error_code(std::errc::io_error));
+      return;
+    }
+    length -= n;
+    while (n) {
+      loff_t file_offset = offset;
+      ssize_t m = splice(pipe->fds[0], nullptr, fd, &file_offset, n,
+                         SPLICE_F_MOVE);
+      if (m < 0 && errno == EINTR) {
+        continue;
+      }
+      if (m <= 0) {
+        Complete(socket, handler,
+                 m ? LastError() : std::make_error_code(std::errc::io_error));
+        return;
+      }
+      offset += m;
+      n -= m;
+    }
+  }
+  Complete(socket, handler, std::error_code());
+}
+}  // namespace
+
+// send region to the socket with sendfile(2)
+// handler(std::error_code) runs on the socket's executor
+template <typename Handler>
+void AsyncSendFile(asio::ip::tcp::socket& socket, const FileRegion& region,
+                   Handler handler) {
+  asio::error_code error;
+  socket.native_non_blocking(true, error);
+  if (error) {
+    Complete(socket, handler, error);
+    return;
+  }
+  SendFileImpl(socket, region, handler);
+}
+
+// receive region.length bytes from the socket into region.fd at
+// region.offset with splice(2) through a pipe
+template <typename Handler>
+void AsyncReceiveFile(asio::ip::tcp::socket& socket, const FileRegion& region,
+                      Handler handler) {
+  asio::error_code error;
+  socket.native_non_blocking(true, error);
+  if (error) {
+    Complete(socket, handler, error);
+    return;
+  }
+  auto pipe = std::make_shared<Pipe>();
+  if (pipe->fds[0] < 0) {
+    Complete(socket, handler, LastError());
+    return;
+  }
+  ReceiveFileImpl(socket, pipe, region.fd, region.offset, region.length,
+                  handler);
+}
+
+}  // namespace tinyrpc
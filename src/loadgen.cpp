@@ -0,0 +1,314 @@
+// end to end load generator for RpcServer
+// usage: loadgen [--ip=127.0.0.1] [--port=9000] [--server=1] [--connections=4]
+//                [--duration=3] [--rate=0] [--sizes=16,256,1024,4000]
+// --server=0 drives an already running server that registered the same
+// handlers, --rate=0 is closed loop (one request in flight per connection),
+// otherwise open loop at rate requests/s in total, latency is then measured
+// from the intended send time so a stalled server is not under-reported
+// sys(us) and csw are the system cpu time and context switches of the
+// server's io thread per request, asked from its "usage" handler so the
+// client threads are not counted, compare them between builds with and
+// without TINYRPC_IO_URING to see the syscall overhead of each backend, they
+// are left out if the server has no such handler
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "asio.hpp"
+#include "message.hpp"
+#include "rpcserver.hpp"
+
+using namespace tinyrpc;
+
+int add(int x, int y) { return x + y; }
+std::string echo(std::string s) { return s; }
+std::string blob(uint32_t size) { return std::string(size, 'x'); }
+
+struct Options {
+  std::string ip = "127.0.0.1";
+  uint16_t port = 9000;
+  bool server = true;
+  std::size_t connections = 4;
+  double duration = 3;
+  double rate = 0;
+  std::vector<uint32_t> sizes{16, 256, 1024, 4000};
+};
+
+struct Workload {
+  std::string method;
+  uint32_t size;
+  std::string request;  // complete frame
+};
+
+#if defined(ASIO_HAS_IO_URING) && defined(ASIO_DISABLE_EPOLL)
+constexpr const char* Backend = "io_uring";
+#else
+constexpr const char* Backend = "epoll";
+#endif
+
+struct Usage {
+  double system;  // microseconds
+  long switches;
+};
+
+// registered as "usage", so it runs on the server's io thread
+Usage usage() {
+  rusage usage;
+  getrusage(RUSAGE_THREAD, &usage);
+  return Usage{usage.ru_stime.tv_sec * 1e6 + usage.ru_stime.tv_usec,
+               usage.ru_nvcsw + usage.ru_nivcsw};
+}
+
+struct Result {
+  std::size_t requests = 0;
+  std::size_t errors = 0;
+  double elapsed = 0;
+  std::vector<uint64_t> latencies;  // nanoseconds
+};
+
+Options Parse(int argc, char* argv[]) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    auto pos = arg.find('=');
+    if (arg.compare(0, 2, "--") || pos == std::string::npos) {
+      std::cerr << "ignore argument " << arg << '\n';
+      continue;
+    }
+    std::string key = arg.substr(2, pos - 2), value = arg.substr(pos + 1);
+    if (key == "ip") {
+      options.ip = value;
+    } else if (key == "port") {
+      options.port = std::stoi(value);
+    } else if (key == "server") {
+      options.server = std::stoi(value);
+    } else if (key == "connections") {
+      options.connections = std::max(1, std::stoi(value));
+    } else if (key == "duration") {
+      options.duration = std::stod(value);
+    } else if (key == "rate") {
+      options.rate = std::stod(value);
+    } else if (key == "sizes") {
+      options.sizes.clear();
+      std::istringstream iss(value);
+      std::string size;
+      while (std::getline(iss, size, ',')) {
+        options.sizes.push_back(std::stoul(size));
+      }
+    } else {
+      std::cerr << "ignore argument " << arg << '\n';
+    }
+  }
+  return options;
+}
+
+// one connection, sends workload.request until deadline
+void Drive(const Options& options, const Workload& workload, Result& result) {
+  asio::io_context io_context;
+  asio::ip::tcp::socket socket(io_context);
+  socket.connect(asio::ip::tcp::endpoint(
+      asio::ip::address::from_string(options.ip), options.port));
+  socket.set_option(asio::ip::tcp::no_delay(true));
+
+  std::vector<char> buffer(Message::MaxLength);
+  auto start = std::chrono::steady_clock::now();
+  auto deadline = start + std::chrono::duration_cast<std::chrono::nanoseconds>(
+                              std::chrono::duration<double>(options.duration));
+  std::chrono::nanoseconds interval(0);
+  if (options.rate > 0) {
+    interval = std::chrono::nanoseconds(
+        static_cast<uint64_t>(1e9 * options.connections / options.rate));
+  }
+  auto intended = start;
+  while (true) {
+    auto now = std::chrono::steady_clock::now();
+    if (options.rate > 0) {
+      if (intended >= deadline) {
+        break;
+      }
+      if (intended > now) {
+        std::this_thread::sleep_until(intended);
+      }
+    } else {
+      if (now >= deadline) {
+        break;
+      }
+      intended = now;
+    }
+    asio::error_code error;
+    asio::write(socket, asio::buffer(workload.request), error);
+    if (!error) {
+      asio::read(socket, asio::buffer(buffer, Message::HeaderLength), error);
+    }
+    if (!error) {
+      Reader header(buffer.data(), Message::HeaderLength);
+      if (!header) {
+        break;
+      }
+      buffer.resize(std::max<std::size_t>(buffer.size(), header.Length()));
+      asio::read(socket, asio::buffer(buffer, header.Length()), error);
+    }
+    if (error) {
+      ++result.errors;
+      break;
+    }
+    result.latencies.push_back(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - intended)
+            .count());
+    ++result.requests;
+    intended += interval;
+  }
+  result.elapsed = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+}
+
+std::optional<Usage> QueryUsage(const Options& options) {
+  asio::io_context io_context;
+  asio::ip::tcp::socket socket(io_context);
+  asio::error_code error;
+  socket.connect(asio::ip::tcp::endpoint(
+                     asio::ip::address::from_string(options.ip), options.port),
+                 error);
+  Writer writer;
+  writer << std::string("usage");
+  if (!error) {
+    asio::write(socket, asio::buffer(writer.GetString()), error);
+  }
+  char buffer[Message::MaxLength];
+  if (!error) {
+    asio::read(socket, asio::buffer(buffer, Message::HeaderLength), error);
+  }
+  if (error) {
+    return std::nullopt;
+  }
+  Reader header(buffer, Message::HeaderLength);
+  if (!header || header.Length() > Message::MaxLength) {
+    return std::nullopt;
+  }
+  asio::read(socket, asio::buffer(buffer, header.Length()), error);
+  if (error) {
+    return std::nullopt;
+  }
+  Reader reader(buffer, header.Length(), false);
+  Usage usage{};
+  reader >> usage;
+  if (!reader) {
+    return std::nullopt;
+  }
+  return usage;
+}
+
+void Report(const Workload& workload, std::vector<Result>& results,
+            const std::optional<Usage>& begin,
+            const std::optional<Usage>& end) {
+  Result total;
+  for (auto& result : results) {
+    total.requests += result.requests;
+    total.errors += result.errors;
+    total.elapsed = std::max(total.elapsed, result.elapsed);
+    total.latencies.insert(total.latencies.end(), result.latencies.begin(),
+                           result.latencies.end());
+  }
+  std::sort(total.latencies.begin(), total.latencies.end());
+  auto percentile = [&](double p) -> double {
+    if (total.latencies.empty()) {
+      return 0;
+    }
+    std::size_t index = std::min<std::size_t>(p * total.latencies.size(),
+                                              total.latencies.size() - 1);
+    return total.latencies[index] / 1e3;
+  };
+  double requests = std::max<std::size_t>(total.requests, 1);
+  std::cout << std::left << std::setw(8) << workload.method << std::right
+            << std::setw(8) << workload.size << std::setw(12)
+            << static_cast<uint64_t>(total.requests / total.elapsed)
+            << std::fixed << std::setprecision(1) << std::setw(12)
+            << percentile(0.5) << std::setw(12) << percentile(0.99)
+            << std::setw(12) << percentile(0.999) << std::setprecision(2);
+  if (begin && end) {
+    std::cout << std::setw(10) << (end->system - begin->system) / requests
+              << std::setw(10) << (end->switches - begin->switches) / requests;
+  } else {
+    std::cout << std::setw(10) << "-" << std::setw(10) << "-";
+  }
+  std::cout << std::setw(8) << total.errors << '\n';
+}
+
+int main(int argc, char* argv[]) {
+  Options options = Parse(argc, argv);
+
+  std::unique_ptr<RpcServer> server;
+  if (options.server) {
+    server = std::make_unique<RpcServer>(options.port);
+    server->Register("add", add);
+    server->Register("echo", echo);
+    server->Register("blob", blob);
+    server->Register("usage", usage);
+    server->Start();
+  }
+
+  std::vector<Workload> workloads;
+  {
+    Writer writer;
+    writer << std::string("add") << 1 << 2;
+    workloads.push_back({"add", sizeof(int) * 2, writer.GetString()});
+  }
+  for (auto size : options.sizes) {
+    Writer writer;
+    writer << std::string("echo") << std::string(size, 'x');
+    if (writer.GetString().size() - Message::HeaderLength >
+        Message::MaxLength) {
+      std::cerr << "skip size " << size << ", frame exceeds "
+                << Message::MaxLength << " bytes\n";
+      continue;
+    }
+    workloads.push_back({"echo", size, writer.GetString()});
+    Writer blob_writer;
+    blob_writer << std::string("blob") << size;
+    workloads.push_back({"blob", size, blob_writer.GetString()});
+  }
+
+  std::cout << Backend << ", "
+            << (options.rate > 0 ? "open loop, " : "closed loop, ")
+            << options.connections << " connections";
+  if (options.rate > 0) {
+    std::cout << ", " << options.rate << " requests/s";
+  }
+  std::cout << ", " << options.duration << " s per workload\n";
+  std::cout << std::left << std::setw(8) << "method" << std::right
+            << std::setw(8) << "size" << std::setw(12) << "req/s"
+            << std::setw(12) << "p50(us)" << std::setw(12) << "p99(us)"
+            << std::setw(12) << "p999(us)" << std::setw(10) << "sys(us)"
+            << std::setw(10) << "csw" << std::setw(8) << "errors"
+            << '\n';
+  for (const auto& workload : workloads) {
+    std::vector<Result> results(options.connections);
+    auto begin = QueryUsage(options);
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < options.connections; ++i) {
+      threads.emplace_back(
+          [&, i]() { Drive(options, workload, results[i]); });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    Report(workload, results, begin, QueryUsage(options));
+  }
+
+  if (server) {
+    server->Stop();
+  }
+  return 0;
+}
@@ -0,0 +1,74 @@
+// reissue the frames of a trace captured by RpcServer::StartCapture
+// usage: replay <trace> <ip> <port> [speed]
+// speed scales the original inter-arrival times, 2 replays twice as fast,
+// 0 replays as fast as possible
+// frames that carried a FileRegion are skipped, the region is not captured
+// and the handler could not run without it
+
+#include <iostream>
+#include <map>
+#include <memory>
+
+#include "asio.hpp"
+#include "trace.hpp"
+
+using namespace tinyrpc;
+
+int main(int argc, char* argv[]) {
+  if (argc < 4) {
+    std::cerr << "usage: " << argv[0] << " <trace> <ip> <port> [speed]\n";
+    return 1;
+  }
+  TraceReader trace(argv[1]);
+  if (!trace) {
+    std::cerr << "can not open trace " << argv[1] << '\n';
+    return 1;
+  }
+  asio::ip::tcp::endpoint endpoint(asio::ip::address::from_string(argv[2]),
+                                   std::stoi(argv[3]));
+  double speed = argc > 4 ? std::stod(argv[4]) : 1.0;
+
+  asio::io_context io_context;
+  // one socket per captured connection
+  std::map<uint32_t, std::unique_ptr<asio::ip::tcp::socket>> sockets;
+  char drain[1 << 16];
+  std::size_t frames = 0, bytes = 0, skipped = 0;
+
+  TraceReader::Frame frame{};
+  uint64_t first = 0;
+  auto start = std::chrono::steady_clock::now();
+  while (trace.Next(frame)) {
+    if (frame.record->attachment) {
+      ++skipped;
+      continue;
+    }
+    if (!frames) {
+      first = frame.record->timestamp;
+    }
+    if (speed > 0) {
+      std::this_thread::sleep_until(
+          start + std::chrono::nanoseconds(static_cast<uint64_t>(
+                      (frame.record->timestamp - first) / speed)));
+    }
+    auto& socket = sockets[frame.record->connection];
+    if (!socket) {
+      socket = std::make_unique<asio::ip::tcp::socket>(io_context);
+      socket->connect(endpoint);
+    }
+    asio::write(*socket, asio::buffer(frame.data, frame.record->length));
+    // responses are discarded, read them so the server never blocks on us
+    while (socket->available()) {
+      socket->read_some(asio::buffer(drain));
+    }
+    ++frames;
+    bytes += frame.record->length;
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  std::cout << "replayed " << frames << " frames (" << bytes << " bytes) on "
+            << sockets.size() << " connections in " << elapsed.count()
+            << " s, " << frames / elapsed.count() << " frames/s, skipped "
+            << skipped << " frames with a file region\n";
+  return 0;
+}
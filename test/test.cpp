@@ -1,9 +1,14 @@
 #define CATCH_CONFIG_MAIN
 
+#include <future>
+#include <mutex>
+
 #include "catch.hpp"
 #include "message.hpp"
 #include "rpcclient.hpp"
+#include "rpchedgedclient.hpp"
 #include "rpcserver.hpp"
+#include "tracer.hpp"
 using namespace tinyrpc;
 
 TEST_CASE("fundamental type") {
@@ -166,6 +171,19 @@ TEST_CASE("map type") {
   REQUIRE(ump2_it->second == 8);
 }
 
+TEST_CASE("trace id") {
+  Writer writer;
+  writer.SetTraceId(0x1234567890abcdefULL);
+  writer << 7;
+
+  Reader reader(writer.GetStringView());
+  int x;
+  reader >> x;
+  REQUIRE(reader.TraceId() == 0x1234567890abcdefULL);
+  REQUIRE(reader.Length() == sizeof(int));
+  REQUIRE(x == 7);
+}
+
 TEST_CASE("error msg") {
   class ugly {
     virtual void print() = 0;
@@ -186,6 +204,22 @@ TEST_CASE("error msg") {
   reader >> tmp;
   CHECK_FALSE(reader);
   REQUIRE(reader.GetErrorMessage() == "unsupported type in reader!");
+
+  // a frame of an older header layout is rejected, not misparsed
+  uint32_t old_frame[6] = {0xc2a9c9a7, 4, 7};
+  Reader old_reader(reinterpret_cast<const char*>(old_frame),
+                    sizeof(old_frame));
+  CHECK_FALSE(old_reader);
+  REQUIRE(old_reader.GetErrorMessage() == "unsupported message type!");
+
+  // reading past the end of a message is an error, not garbage
+  Writer short_writer;
+  short_writer << std::size_t{1000};
+  Reader short_reader(short_writer.GetStringView());
+  std::string s;
+  short_reader >> s;
+  CHECK_FALSE(short_reader);
+  REQUIRE(short_reader.GetErrorMessage() == "message is too short!");
 }
 
 TEST_CASE("message exchange") {
@@ -277,4 +311,613 @@ TEST_CASE("server invoke") {
     server_thread.join();
   }
   client.Stop();
-}
\ No newline at end of file
+}
+TEST_CASE("server pipeline") {
+  RpcServer server(8889);
+  server.Register("add", add);
+  server.Register("echo", echo);
+  server.Start();
+
+  asio::io_context io_context;
+  asio::ip::tcp::socket socket(io_context);
+  socket.connect(asio::ip::tcp::endpoint(
+      asio::ip::address::from_string("127.0.0.1"), 8889));
+
+  // many frames in one write, the last one split across two writes
+  std::string requests;
+  for (int i = 0; i < 100; i++) {
+    Writer writer;
+    writer << std::string("add") << i << i;
+    requests += writer.GetString();
+  }
+  Writer writer;
+  writer << std::string("echo") << std::string("pipeline");
+  std::string last = writer.GetString();
+  requests += last.substr(0, last.size() / 2);
+  asio::write(socket, asio::buffer(requests));
+  asio::write(socket, asio::buffer(last.substr(last.size() / 2)));
+
+  char buffer[Message::MaxLength];
+  for (int i = 0; i < 100; i++) {
+    asio::read(socket, asio::buffer(buffer, Message::HeaderLength));
+    Reader header(buffer, Message::HeaderLength);
+    REQUIRE(header);
+    asio::read(socket, asio::buffer(buffer, header.Length()));
+    Reader reader(buffer, header.Length(), false);
+    int result;
+    reader >> result;
+    REQUIRE(result == i + i + 10);
+  }
+  asio::read(socket, asio::buffer(buffer, Message::HeaderLength));
+  Reader header(buffer, Message::HeaderLength);
+  asio::read(socket, asio::buffer(buffer, header.Length()));
+  Reader reader(buffer, header.Length(), false);
+  std::string result;
+  reader >> result;
+  REQUIRE(result == "pipeline");
+
+  socket.close();
+  server.Stop();
+}
+
+TEST_CASE("hot register") {
+  RpcServer server(8890);
+  server.Register("add", add);
+  server.Start();
+
+  std::atomic<bool> done{false};
+  std::thread deployer([&]() {
+    while (!done) {
+      server.Register("echo", echo);
+      server.UnRegister("echo");
+    }
+  });
+
+  asio::io_context io_context;
+  asio::ip::tcp::socket socket(io_context);
+  socket.connect(asio::ip::tcp::endpoint(
+      asio::ip::address::from_string("127.0.0.1"), 8890));
+  char buffer[Message::MaxLength];
+  for (int i = 0; i < 1000; i++) {
+    Writer writer;
+    writer << std::string("add") << i << 1;
+    asio::write(socket, asio::buffer(writer.GetString()));
+    asio::read(socket, asio::buffer(buffer, Message::HeaderLength));
+    Reader header(buffer, Message::HeaderLength);
+    asio::read(socket, asio::buffer(buffer, header.Length()));
+    Reader reader(buffer, header.Length(), false);
+    int result;
+    reader >> result;
+    REQUIRE(result == i + 1 + 10);
+  }
+  done = true;
+  deployer.join();
+
+  // unknown method gets an empty response
+  Writer writer;
+  writer << std::string("echo") << std::string("gone");
+  asio::write(socket, asio::buffer(writer.GetString()));
+  asio::read(socket, asio::buffer(buffer, Message::HeaderLength));
+  Reader header(buffer, Message::HeaderLength);
+  REQUIRE(header);
+  REQUIRE(header.Length() == 0);
+
+  // which the client does not decode, the connection stays usable
+  RpcClient client("127.0.0.1", 8890);
+  client.Start();
+  std::atomic<bool> called{false};
+  client.Call<std::string>(
+      "echo", [&](std::string& result) { called = true; },
+      std::string("gone"));
+  std::promise<int> promise;
+  client.Call<int>(
+      "add", [&](int& result) { promise.set_value(result); }, 1, 2);
+  REQUIRE(promise.get_future().get() == 1 + 2 + 10);
+  REQUIRE_FALSE(called);
+  client.Stop();
+
+  // the object of a handler may be deleted once it is unregistered
+  auto suber = std::make_unique<Suber>();
+  server.Register("sub", suber.get(), &Suber::sub);
+  std::atomic<bool> stop{false};
+  std::thread caller([&]() {
+    char buffer[Message::MaxLength];
+    while (!stop) {
+      Writer writer;
+      writer << std::string("sub") << 3 << 1;
+      asio::write(socket, asio::buffer(writer.GetString()));
+      asio::read(socket, asio::buffer(buffer, Message::HeaderLength));
+      Reader header(buffer, Message::HeaderLength);
+      asio::read(socket, asio::buffer(buffer, header.Length()));
+    }
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  server.UnRegister("sub");
+  suber.reset();
+  stop = true;
+  caller.join();
+
+  socket.close();
+  server.Stop();
+}
+
+class Delayer {
+ public:
+  std::string echo(std::string s) {
+    std::this_thread::sleep_for(delay);
+    return s;
+  }
+  std::chrono::milliseconds delay{0};
+};
+TEST_CASE("hedged call") {
+  Delayer delayer1, delayer2;
+  RpcServer server1(8891), server2(8892);
+  server1.Register("echo", &delayer1, &Delayer::echo);
+  server2.Register("echo", &delayer2, &Delayer::echo);
+  server1.Start();
+  server2.Start();
+
+  RpcHedgedClient client({{"127.0.0.1", 8891}, {"127.0.0.1", 8892}});
+  client.Start();
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  auto call = [&]() {
+    std::promise<std::string> promise;
+    client.HedgedCall<std::string>(
+        "echo", [&](std::string& result) { promise.set_value(result); },
+        std::string("hedge"));
+    return promise.get_future().get();
+  };
+  for (int i = 0; i < 20; i++) {
+    REQUIRE(call() == "hedge");
+  }
+  REQUIRE(client.HedgeCount() == 0);
+
+  delayer1.delay = std::chrono::milliseconds(1000);
+  auto start = std::chrono::steady_clock::now();
+  REQUIRE(call() == "hedge");
+  REQUIRE(std::chrono::steady_clock::now() - start <
+          std::chrono::milliseconds(500));
+  REQUIRE(client.HedgeCount() == 1);
+
+  client.Stop();
+  server1.Stop();
+  server2.Stop();
+}
+
+TEST_CASE("traffic capture") {
+  std::string path = "capture.trace";
+  RpcServer server(8893);
+  server.Register("add", add);
+  server.Register("size", +[](FileRegion region) { return region.length; });
+  server.Start();
+  REQUIRE(server.StartCapture(path));
+
+  asio::io_context io_context;
+  asio::ip::tcp::socket socket(io_context);
+  socket.connect(asio::ip::tcp::endpoint(
+      asio::ip::address::from_string("127.0.0.1"), 8893));
+  std::vector<std::string> requests;
+  char buffer[Message::MaxLength];
+  for (int i = 0; i < 10; i++) {
+    Writer writer;
+    writer << std::string("add") << i << i;
+    requests.push_back(writer.GetString());
+    asio::write(socket, asio::buffer(requests.back()));
+    asio::read(socket, asio::buffer(buffer, Message::HeaderLength));
+    Reader header(buffer, Message::HeaderLength);
+    asio::read(socket, asio::buffer(buffer, header.Length()));
+  }
+  {
+    Writer writer;
+    writer << std::string("size") << FileRegion{-1, 0, 5};
+    requests.push_back(writer.GetString());
+    asio::write(socket, asio::buffer(requests.back() + "abcde"));
+    asio::read(socket, asio::buffer(buffer, Message::HeaderLength));
+    Reader header(buffer, Message::HeaderLength);
+    asio::read(socket, asio::buffer(buffer, header.Length()));
+  }
+  REQUIRE(server.StopCapture() == 0);
+
+  TraceReader trace(path);
+  REQUIRE(trace);
+  TraceReader::Frame frame{};
+  uint64_t timestamp = 0;
+  for (int i = 0; i < 10; i++) {
+    REQUIRE(trace.Next(frame));
+    REQUIRE(frame.record->timestamp >= timestamp);
+    REQUIRE(frame.record->connection == 0);
+    REQUIRE(std::string(frame.data, frame.record->length) == requests[i]);
+    timestamp = frame.record->timestamp;
+  }
+  // the file region is not captured, nor announced by the captured header
+  REQUIRE(trace.Next(frame));
+  REQUIRE(frame.record->attachment == 5);
+  REQUIRE(frame.record->length == requests[10].size());
+  Reader header(frame.data, frame.record->length);
+  REQUIRE(header);
+  REQUIRE(header.Attachment() == 0);
+  REQUIRE(std::string(frame.data + Message::HeaderLength,
+                      frame.record->length - Message::HeaderLength) ==
+          requests[10].substr(Message::HeaderLength));
+  REQUIRE_FALSE(trace.Next(frame));
+
+  socket.close();
+  server.Stop();
+  std::remove(path.c_str());
+}
+
+TEST_CASE("request tracing") {
+  RpcServer server(8894);
+  server.Register("add", add);
+  server.Start();
+  RpcClient client("127.0.0.1", 8894);
+  client.Start();
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  Tracer::Instance().SetSampleRate(1);
+  std::promise<int> promise;
+  client.Call<int>(
+      "add", [&](int& result) { promise.set_value(result); }, 1, 2);
+  REQUIRE(promise.get_future().get() == 1 + 2 + 10);
+  Tracer::Instance().SetSampleRate(0);
+  // let the server finish the write span of the response
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  client.Stop();
+  server.Stop();
+
+  std::string dump = Tracer::Instance().Dump();
+  REQUIRE(dump.rfind("{\"traceEvents\":[", 0) == 0);
+  for (auto name : {"send", "wait", "call", "queue", "decode name",
+                    "decode args", "handler", "encode", "write"}) {
+    REQUIRE(dump.find("\"name\":\"" + std::string(name) + "\"") !=
+            std::string::npos);
+  }
+  // client and server spans share the trace id of the call
+  auto pos = dump.find("\"trace_id\":\"");
+  REQUIRE(pos != std::string::npos);
+  std::string trace_id = dump.substr(pos, dump.find('}', pos) - pos);
+  std::size_t spans = 0;
+  for (pos = dump.find(trace_id); pos != std::string::npos;
+       pos = dump.find(trace_id, pos + 1)) {
+    ++spans;
+  }
+  REQUIRE(spans == 9);
+}
+
+// length bytes of a known pattern after skip bytes of garbage
+// also called by handlers, so it does not use REQUIRE off the test thread
+int MakeFile(uint64_t length, uint64_t skip = 0) {
+  int fd = CreateTempFile();
+  std::string data(skip + length, '#');
+  for (uint64_t i = 0; i < length; i++) {
+    data[skip + i] = static_cast<char>(i * 7 + 3);
+  }
+  if (write(fd, data.data(), data.size()) !=
+      static_cast<ssize_t>(data.size())) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+bool CheckFile(const FileRegion& region) {
+  std::string data(region.length, '\0');
+  if (pread(region.fd, data.data(), region.length, region.offset) !=
+      static_cast<ssize_t>(region.length)) {
+    return false;
+  }
+  for (uint64_t i = 0; i < region.length; i++) {
+    if (data[i] != static_cast<char>(i * 7 + 3)) {
+      return false;
+    }
+  }
+  return true;
+}
+FileRegion serve(uint64_t length) {
+  return FileRegion{MakeFile(length), 0, length};
+}
+bool check(FileRegion region, int tag) {
+  return tag == 5 && CheckFile(region);
+}
+FileRegion bounce(FileRegion region) { return region; }
+TEST_CASE("file region") {
+  const uint64_t length = 8 << 20;
+  RpcServer server(8895);
+  server.Register("serve", serve);
+  server.Register("check", check);
+  server.Register("bounce", bounce);
+  server.Register("add", add);
+  server.Start();
+  RpcClient client("127.0.0.1", 8895);
+  client.Start();
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  SECTION("result") {
+    std::promise<bool> promise;
+    client.Call<FileRegion>(
+        "serve",
+        [&](FileRegion& region) {
+          promise.set_value(region.length == length && CheckFile(region));
+        },
+        length);
+    REQUIRE(promise.get_future().get());
+  }
+  SECTION("empty result") {
+    std::promise<FileRegion> promise;
+    client.Call<FileRegion>(
+        "serve", [&](FileRegion& region) { promise.set_value(region); },
+        uint64_t{0});
+    auto region = promise.get_future().get();
+    REQUIRE(region.fd == -1);
+    REQUIRE(region.length == 0);
+
+    int fd = CreateTempFile();
+    std::promise<FileRegion> sink_promise;
+    client.CallInto<FileRegion>(
+        FileRegion{fd, 100, length}, "serve",
+        [&](FileRegion& region) { sink_promise.set_value(region); },
+        uint64_t{0});
+    region = sink_promise.get_future().get();
+    REQUIRE(region.fd == fd);
+    REQUIRE(region.offset == 100);
+    REQUIRE(region.length == 0);
+    close(fd);
+  }
+  SECTION("sink too small") {
+    int fd = CreateTempFile();
+    std::atomic<bool> called{false};
+    client.CallInto<FileRegion>(
+        FileRegion{fd, 0, length - 1}, "serve",
+        [&](FileRegion& region) { called = true; }, length);
+    // the connection is given up, the next call fails instead of hanging
+    client.Call<int>(
+        "add", [&](int& result) { called = true; }, 1, 2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    REQUIRE_FALSE(called);
+    close(fd);
+  }
+  SECTION("result into sink") {
+    int fd = CreateTempFile();
+    std::promise<FileRegion> promise;
+    client.CallInto<FileRegion>(
+        FileRegion{fd, 100, length}, "serve",
+        [&](FileRegion& region) { promise.set_value(region); }, length);
+    auto region = promise.get_future().get();
+    REQUIRE(region.fd == fd);
+    REQUIRE(region.offset == 100);
+    REQUIRE(region.length == length);
+    REQUIRE(CheckFile(region));
+    close(fd);
+  }
+  SECTION("argument") {
+    FileRegion region{MakeFile(length, 10), 10, length};
+    std::promise<bool> check_promise;
+    client.Call<bool>(
+        "check", [&](bool& result) { check_promise.set_value(result); },
+        region, 5);
+    REQUIRE(check_promise.get_future().get());
+
+    std::promise<bool> bounce_promise;
+    client.Call<FileRegion>(
+        "bounce",
+        [&](FileRegion& result) {
+          bounce_promise.set_value(result.length == length &&
+                                   CheckFile(result));
+        },
+        region);
+    REQUIRE(bounce_promise.get_future().get());
+
+    // the connection is still in sync
+    std::promise<int> add_promise;
+    client.Call<int>(
+        "add", [&](int& result) { add_promise.set_value(result); }, 1, 2);
+    REQUIRE(add_promise.get_future().get() == 13);
+    close(region.fd);
+  }
+  SECTION("argument too large") {
+    FileRegion region{MakeFile(length, 0), 0, length};
+    server.SetMaxAttachment(length - 1);
+    std::atomic<bool> called{false};
+    client.Call<bool>(
+        "check", [&](bool& result) { called = true; }, region, 5);
+    // the server closes the connection before receiving the region
+    client.Call<int>(
+        "add", [&](int& result) { called = true; }, 1, 2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    REQUIRE_FALSE(called);
+
+    server.SetMaxAttachment(length);
+    RpcClient other("127.0.0.1", 8895);
+    other.Start();
+    std::promise<bool> promise;
+    other.Call<bool>(
+        "check", [&](bool& result) { promise.set_value(result); }, region,
+        5);
+    REQUIRE(promise.get_future().get());
+    other.Stop();
+    close(region.fd);
+  }
+
+  client.Stop();
+  server.Stop();
+}
+
+int slow_add(int x, int y) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  return x + y;
+}
+class Proxy {
+ public:
+  Proxy(uint16_t port) : client("127.0.0.1", port) { client.Start(); }
+  void forward(int x, int y, Responder<int> responder) {
+    client.Call<int>(
+        "slow_add", [responder](int& result) { responder(result * 2); }, x,
+        y);
+  }
+  void drop(Responder<int> responder) {}
+  void drop_string(Responder<std::string> responder) {}
+  void hold(Responder<int> responder) {
+    std::lock_guard<std::mutex> lock(held_lock);
+    held.push_back(responder);
+  }
+  // answers every held request, returns how many there were
+  std::size_t Release() {
+    std::lock_guard<std::mutex> lock(held_lock);
+    for (auto& responder : held) {
+      responder(0);
+    }
+    std::size_t count = held.size();
+    held.clear();
+    return count;
+  }
+  void now(Responder<int> responder) { responder(1); }
+  // replies from another thread once the uploaded file was read back
+  void later(FileRegion region, Responder<FileRegion> responder) {
+    workers.emplace_back([region, responder]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      responder(CheckFile(region) ? region : FileRegion{-1, 0, 0});
+    });
+  }
+  ~Proxy() {
+    for (auto& worker : workers) {
+      worker.join();
+    }
+  }
+  RpcClient client;
+  std::vector<std::thread> workers;
+  std::mutex held_lock;
+  std::vector<Responder<int>> held;
+};
+TEST_CASE("async handler") {
+  RpcServer backend(8896);
+  backend.Register("slow_add", slow_add);
+  backend.Start();
+  RpcServer server(8897);
+  Proxy proxy(8896);
+  server.Register("forward", &proxy, &Proxy::forward);
+  server.Register("drop", &proxy, &Proxy::drop);
+  server.Register("drop_string", &proxy, &Proxy::drop_string);
+  server.Register("hold", &proxy, &Proxy::hold);
+  server.Register("now", &proxy, &Proxy::now);
+  server.Register("later", &proxy, &Proxy::later);
+  server.Register("add", add);
+  server.Start();
+
+  asio::io_context io_context;
+  asio::ip::tcp::socket socket(io_context), other(io_context),
+      third(io_context);
+  asio::ip::tcp::endpoint endpoint(asio::ip::address::from_string("127.0.0.1"),
+                                   8897);
+  socket.connect(endpoint);
+  other.connect(endpoint);
+  third.connect(endpoint);
+  auto request = [](const std::string& name, auto... args) {
+    Writer writer;
+    writer << name;
+    static_cast<void>((writer << ... << args));
+    return writer.GetString();
+  };
+  char buffer[Message::MaxLength];
+  auto response = [&](asio::ip::tcp::socket& socket) {
+    asio::read(socket, asio::buffer(buffer, Message::HeaderLength));
+    Reader header(buffer, Message::HeaderLength);
+    asio::read(socket, asio::buffer(buffer, header.Length()));
+    return header.Length();
+  };
+  auto result = [&]() {
+    Reader reader(buffer, sizeof(int), false);
+    int x;
+    reader >> x;
+    return x;
+  };
+
+  // responses keep the request order even though add completes first
+  asio::write(third, asio::buffer(request("forward", 7, 8)));
+  asio::write(socket, asio::buffer(request("forward", 1, 2) +
+                                   request("drop") + request("add", 3, 4)));
+  // the io thread is not blocked by the two outstanding calls
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  auto start = std::chrono::steady_clock::now();
+  asio::write(other, asio::buffer(request("add", 5, 6)));
+  REQUIRE(response(other) == sizeof(int));
+  REQUIRE(result() == 5 + 6 + 10);
+  REQUIRE(std::chrono::steady_clock::now() - start <
+          std::chrono::milliseconds(200));
+
+  REQUIRE(response(socket) == sizeof(int));
+  REQUIRE(result() == (1 + 2) * 2);
+  REQUIRE(response(socket) == 0);
+  REQUIRE(response(socket) == sizeof(int));
+  REQUIRE(result() == 3 + 4 + 10);
+  REQUIRE(response(third) == sizeof(int));
+  REQUIRE(result() == (7 + 8) * 2);
+
+  // the uploaded file stays open until the deferred reply is sent
+  RpcClient client("127.0.0.1", 8897);
+  client.Start();
+  const uint64_t length = 1 << 20;
+  FileRegion region{MakeFile(length), 0, length};
+  std::promise<bool> promise;
+  client.Call<FileRegion>(
+      "later",
+      [&](FileRegion& result) {
+        promise.set_value(result.length == length && CheckFile(result));
+      },
+      region);
+  REQUIRE(promise.get_future().get());
+  close(region.fd);
+
+  // an empty reply fails the call instead of being decoded, the next one
+  // still gets its own result
+  std::atomic<bool> called{false};
+  client.Call<std::string>(
+      "drop_string", [&](std::string& result) { called = true; });
+  std::promise<int> add_promise;
+  client.Call<int>(
+      "add", [&](int& result) { add_promise.set_value(result); }, 1, 2);
+  REQUIRE(add_promise.get_future().get() == 1 + 2 + 10);
+  REQUIRE_FALSE(called);
+  client.Stop();
+
+  // requests that are not answered stop the reads, not just a slow client
+  const int holds = 10000;
+  asio::ip::tcp::socket fourth(io_context);
+  fourth.connect(endpoint);
+  std::thread sender([&]() {
+    std::string data;
+    for (int i = 0; i < holds; i++) {
+      data += request("hold");
+    }
+    asio::write(fourth, asio::buffer(data));
+  });
+  std::atomic<int> answered{0};
+  std::thread receiver([&]() {
+    char buffer[Message::MaxLength];
+    for (int i = 0; i < holds; i++) {
+      asio::read(fourth, asio::buffer(buffer, Message::HeaderLength));
+      Reader header(buffer, Message::HeaderLength);
+      asio::read(fourth, asio::buffer(buffer, header.Length()));
+      answered++;
+    }
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  std::size_t released = proxy.Release();
+  REQUIRE(released < holds);
+  while (answered < holds) {
+    released += proxy.Release();
+    REQUIRE(released <= holds);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  sender.join();
+  receiver.join();
+  fourth.close();
+
+  // without a way to defer the reply the responder does nothing
+  Writer writer;
+  REQUIRE_FALSE(server.Call("now", Reader("", 0, false), writer));
+
+  socket.close();
+  other.close();
+  third.close();
+  server.Stop();
+  backend.Stop();
+}